@@ -1,5 +1,24 @@
 @echo off
 
 pushd %~dp0
-clang++ -o breakout.exe code/game.cpp code/audio_win32.cpp -O0 -g -Wall -Wextra -Werror -Wno-unused-function -luser32.lib -lgdi32.lib
+clang++ -o asset_packer.exe code/asset_packer.cpp -O0 -g -Wall -Wextra -Werror -Wno-unused-function
+if errorlevel 1 (popd & exit /b 1)
+asset_packer.exe data/assets.pack data data/sounds/wooh.wav data/images/tile.bmp data/images/paddle.bmp data/images/ball.bmp
+if errorlevel 1 (popd & exit /b 1)
+clang++ -o breakout.exe code/game.cpp code/audio_win32.cpp code/capture_win32.cpp -O0 -g -mssse3 -Wall -Wextra -Werror -Wno-unused-function -luser32.lib -lgdi32.lib
+if errorlevel 1 (popd & exit /b 1)
+clang++ -o batch_sim.exe code/batch_sim.cpp -O2 -g -Wall -Wextra -Werror -Wno-unused-function
+if errorlevel 1 (popd & exit /b 1)
+clang++ -o render_test.exe code/render_test.cpp -O2 -g -mssse3 -Wall -Wextra -Werror -Wno-unused-function
+if errorlevel 1 (popd & exit /b 1)
+render_test.exe
+if errorlevel 1 (popd & exit /b 1)
+clang++ -o rewind_test.exe code/rewind_test.cpp -O2 -g -Wall -Wextra -Werror -Wno-unused-function
+if errorlevel 1 (popd & exit /b 1)
+rewind_test.exe
+if errorlevel 1 (popd & exit /b 1)
+clang++ -o rollback_test.exe code/rollback_test.cpp -O2 -g -Wall -Wextra -Werror -Wno-unused-function
+if errorlevel 1 (popd & exit /b 1)
+rollback_test.exe
+if errorlevel 1 (popd & exit /b 1)
 popd
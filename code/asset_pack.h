@@ -0,0 +1,183 @@
+#ifndef BREAKOUT_ASSET_PACK_H_
+#define BREAKOUT_ASSET_PACK_H_
+
+#include "audio.h"
+#include "render.h"
+
+// Archive layout, as written by asset_packer:
+//   AssetPackHeader
+//   AssetPackEntry[slotCount] - open addressed table keyed by name hash
+//   names, the bytes of every asset name without terminators
+//   payloads, each starting on an ASSET_PACK_ALIGNMENT boundary
+//
+// Payloads are stored in the format the engine uses at runtime so they
+// can be used straight out of the mapped file without any conversion.
+
+static constexpr u32 ASSET_PACK_MAGIC     = MAGICWORD('B','K','P','K');
+static constexpr u32 ASSET_PACK_VERSION   = 2;
+static constexpr u64 ASSET_PACK_ALIGNMENT = 64;
+
+enum AssetType : u32 {
+    ASSET_TYPE_NONE  = 0,
+    ASSET_TYPE_RAW   = 1, // bytes as found on disk
+    ASSET_TYPE_SOUND = 2, // AssetSound followed by interleaved i16 samples
+    ASSET_TYPE_IMAGE = 3, // AssetImage followed by premultiplied 0xAARRGGBB pixels
+};
+
+struct AssetPackHeader {
+    u32 magic;
+    u32 version;
+    u32 entryCount;
+    u32 slotCount;  // power of two
+    u64 slotsOffset;
+    u64 fileSize;
+};
+
+struct AssetPackEntry {
+    u64 nameHash;   // 0 marks an empty slot
+    u64 nameOffset; // from the start of the archive, the hash only picks the slot
+    u64 offset;     // from the start of the archive
+    u64 size;
+    u32 type;
+    u32 nameLength;
+};
+
+struct AssetSound {
+    u32 sampleRate;
+    u32 channelCount;
+    u64 frameCount;
+    // sampledData, ASSET_PACK_ALIGNMENT aligned
+};
+
+struct AssetImage {
+    u32 width;
+    u32 height;
+    // pixels, ASSET_PACK_ALIGNMENT aligned
+};
+
+struct AssetPack {
+    u8*              memory;
+    usize            size;
+    AssetPackHeader* header;
+    AssetPackEntry*  slots;
+};
+
+// FNV-1a, with 0 reserved for empty slots
+static u64 hashAssetName(const char* name) {
+    u64 hash = 0xcbf29ce484222325ull;
+    for (const u8* c = (const u8*)name; *c; c++) {
+        hash ^= *c;
+        hash *= 0x100000001b3ull;
+    }
+    return hash != 0 ? hash : 1;
+}
+
+static bool assetPackOpen(AssetPack* pack, void* memory, usize size) {
+    *pack = {};
+    if (memory == NULL || size < sizeof(AssetPackHeader)) {
+        return false;
+    }
+
+    AssetPackHeader* header = (AssetPackHeader*)memory;
+    if (header->magic != ASSET_PACK_MAGIC || header->version != ASSET_PACK_VERSION) {
+        LOG("Asset pack has an unknown format\n");
+        return false;
+    }
+    if (header->fileSize != size || header->slotCount == 0 ||
+        (header->slotCount & (header->slotCount - 1)) != 0 ||
+        header->slotsOffset + header->slotCount*sizeof(AssetPackEntry) > size) {
+        LOG("Asset pack is corrupted\n");
+        return false;
+    }
+
+    pack->memory = (u8*)memory;
+    pack->size   = size;
+    pack->header = header;
+    pack->slots  = (AssetPackEntry*)(pack->memory + header->slotsOffset);
+    return true;
+}
+
+static AssetPackEntry* assetPackFind(AssetPack* pack, const char* name) {
+    if (!pack->header) {
+        return NULL;
+    }
+
+    u64   hash       = hashAssetName(name);
+    usize nameLength = strlen(name);
+    u32   mask       = pack->header->slotCount - 1;
+    for (u32 probes = 0, i = (u32)hash & mask; probes <= mask; probes++, i = (i + 1) & mask) {
+        AssetPackEntry* entry = &pack->slots[i];
+        if (entry->nameHash == 0) {
+            return NULL;
+        }
+        if (entry->nameHash == hash && entry->nameLength == nameLength &&
+            entry->nameOffset <= pack->size && nameLength <= pack->size - entry->nameOffset &&
+            memcmp(pack->memory + entry->nameOffset, name, nameLength) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static void* assetPackGet(AssetPack* pack, const char* name, AssetType type, usize* size = NULL) {
+    AssetPackEntry* entry = assetPackFind(pack, name);
+    if (!entry || entry->type != type) {
+        LOG("Asset %s not found in pack\n", name);
+        return NULL;
+    }
+    if (entry->offset > pack->size || entry->size > pack->size - entry->offset ||
+        (entry->offset & (ASSET_PACK_ALIGNMENT - 1)) != 0) {
+        LOG("Asset %s lies outside the pack\n", name);
+        return NULL;
+    }
+
+    if (size) {
+        *size = (usize)entry->size;
+    }
+    return pack->memory + entry->offset;
+}
+
+// The returned track references the samples inside the pack, so the pack
+// has to stay mapped for as long as the track is in use.
+static AudioTrack* assetPackGetSound(Arena* arena, AssetPack* pack, const char* name) {
+    usize       size;
+    AssetSound* sound = (AssetSound*)assetPackGet(pack, name, ASSET_TYPE_SOUND, &size);
+    if (!sound) {
+        return NULL;
+    }
+    if (size < ASSET_PACK_ALIGNMENT || sound->channelCount == 0 ||
+        sound->frameCount > (size - ASSET_PACK_ALIGNMENT) / (sound->channelCount * sizeof(i16))) {
+        LOG("Sound %s is larger than its asset\n", name);
+        return NULL;
+    }
+
+    AudioTrack* track = push(arena, AudioTrack);
+    *track = {};
+    track->sampleRate   = sound->sampleRate;
+    track->channelCount = sound->channelCount;
+    track->sampledData  = (i16*)((u8*)sound + ASSET_PACK_ALIGNMENT);
+    track->frameCount   = sound->frameCount;
+    return track;
+}
+
+// Like assetPackGetSound the pixels stay inside the pack.
+static Bitmap* assetPackGetBitmap(Arena* arena, AssetPack* pack, const char* name) {
+    usize       size;
+    AssetImage* image = (AssetImage*)assetPackGet(pack, name, ASSET_TYPE_IMAGE, &size);
+    if (!image) {
+        return NULL;
+    }
+    if (size < ASSET_PACK_ALIGNMENT ||
+        (u64)image->width * image->height > (size - ASSET_PACK_ALIGNMENT) / sizeof(u32)) {
+        LOG("Image %s is larger than its asset\n", name);
+        return NULL;
+    }
+
+    Bitmap* bitmap = push(arena, Bitmap);
+    bitmap->data   = (u32*)((u8*)image + ASSET_PACK_ALIGNMENT);
+    bitmap->width  = image->width;
+    bitmap->height = image->height;
+    return bitmap;
+}
+
+#endif // BREAKOUT_ASSET_PACK_H_
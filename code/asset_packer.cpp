@@ -0,0 +1,254 @@
+// Bakes loose asset files into a single archive that the game maps at startup.
+//
+// usage: asset_packer <output> <root> <asset>...
+//
+// Assets are looked up at runtime by their path relative to <root>, using
+// forward slashes, e.g. data/sounds/wooh.wav with root data is "sounds/wooh.wav".
+
+#include "asset_pack.h"
+
+struct PackedAsset {
+    const char* name;
+    AssetType   type;
+    u8*         data;
+    usize       size;
+    u64         offset;
+};
+
+static constexpr u32 MAX_PACKED_ASSETS = 1024;
+
+static bool hasExtension(const char* fileName, const char* extension) {
+    usize nameLength      = strlen(fileName);
+    usize extensionLength = strlen(extension);
+    if (nameLength < extensionLength) {
+        return false;
+    }
+    const char* a = fileName + nameLength - extensionLength;
+    for (usize i = 0; i < extensionLength; i++) {
+        char c = a[i] >= 'A' && a[i] <= 'Z' ? a[i] - 'A' + 'a' : a[i];
+        if (c != extension[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static u8* readWholeFile(Arena* arena, const char* fileName, usize* size) {
+    FILE* file;
+    if (fopen_s(&file, fileName, "rb") != 0) {
+        LOG("Error opening %s\n", fileName);
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long fileSize = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    u8* buffer = (u8*)allocate(arena, (usize)fileSize, ASSET_PACK_ALIGNMENT);
+    ASSERT(buffer != NULL);
+    fread(buffer, fileSize, 1, file);
+    fclose(file);
+
+    *size = (usize)fileSize;
+    return buffer;
+}
+
+static bool packSound(Arena* arena, Arena* scratch, PackedAsset* asset, const char* fileName) {
+    usize scratchOffset = scratch->offset;
+    AudioTrack* track = readWaveFile(scratch, scratch, fileName);
+    if (!track) {
+        return false;
+    }
+
+    usize sampleSize = track->frameCount * track->channelCount * sizeof(i16);
+    asset->size = ASSET_PACK_ALIGNMENT + sampleSize;
+    asset->data = (u8*)allocate(arena, asset->size, ASSET_PACK_ALIGNMENT);
+    ASSERT(asset->data != NULL);
+    memset(asset->data, 0, ASSET_PACK_ALIGNMENT);
+
+    AssetSound* sound = (AssetSound*)asset->data;
+    sound->sampleRate   = track->sampleRate;
+    sound->channelCount = track->channelCount;
+    sound->frameCount   = track->frameCount;
+    memcpy(asset->data + ASSET_PACK_ALIGNMENT, track->sampledData, sampleSize);
+
+    scratch->offset = scratchOffset;
+    return true;
+}
+
+static bool packImage(Arena* arena, Arena* scratch, PackedAsset* asset, const char* fileName) {
+    usize scratchOffset = scratch->offset;
+    Bitmap* bitmap = readImageFile(scratch, scratch, fileName);
+    if (!bitmap) {
+        return false;
+    }
+
+    usize pixelSize = sizeof(u32) * bitmap->width*bitmap->height;
+    asset->size = ASSET_PACK_ALIGNMENT + pixelSize;
+    asset->data = (u8*)allocate(arena, asset->size, ASSET_PACK_ALIGNMENT);
+    ASSERT(asset->data != NULL);
+    memset(asset->data, 0, ASSET_PACK_ALIGNMENT);
+
+    AssetImage* image = (AssetImage*)asset->data;
+    image->width  = bitmap->width;
+    image->height = bitmap->height;
+    memcpy(asset->data + ASSET_PACK_ALIGNMENT, bitmap->data, pixelSize);
+
+    scratch->offset = scratchOffset;
+    return true;
+}
+
+static void writePadding(FILE* file, u64* written, u64 alignment) {
+    static const u8 zeros[ASSET_PACK_ALIGNMENT] = {};
+    u64 padding = (alignment - (*written & (alignment - 1))) & (alignment - 1);
+    fwrite(zeros, 1, padding, file);
+    *written += padding;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        LOG("usage: %s <output> <root> <asset>...\n", argv[0]);
+        return 1;
+    }
+    const char* outputFileName = argv[1];
+    const char* root           = argv[2];
+    usize       rootLength     = strlen(root);
+
+    Arena arena = {};
+    arena.capacity = (usize)MB(256);
+    arena.memory   = (u8*)malloc(arena.capacity);
+    Arena scratch = {};
+    scratch.capacity = (usize)MB(64);
+    scratch.memory   = (u8*)malloc(scratch.capacity);
+    ASSERT(arena.memory != NULL && scratch.memory != NULL);
+
+    static PackedAsset assets[MAX_PACKED_ASSETS];
+    u32 assetCount = 0;
+
+    for (int i = 3; i < argc; i++) {
+        const char* fileName = argv[i];
+        if (strncmp(fileName, root, rootLength) != 0) {
+            LOG("%s is not inside %s\n", fileName, root);
+            return 1;
+        }
+        if (assetCount == MAX_PACKED_ASSETS) {
+            LOG("Too many assets, at most %u are supported\n", MAX_PACKED_ASSETS);
+            return 1;
+        }
+
+        const char* relativeName = fileName + rootLength;
+        while (*relativeName == '/' || *relativeName == '\\') {
+            relativeName++;
+        }
+        char* name = (char*)allocate(&arena, strlen(relativeName) + 1);
+        for (usize c = 0; ; c++) {
+            name[c] = relativeName[c] == '\\' ? '/' : relativeName[c];
+            if (!name[c]) {
+                break;
+            }
+        }
+
+        PackedAsset* asset = &assets[assetCount++];
+        *asset = {};
+        asset->name = name;
+
+        bool packed;
+        if (hasExtension(fileName, ".wav")) {
+            asset->type = ASSET_TYPE_SOUND;
+            packed = packSound(&arena, &scratch, asset, fileName);
+        } else if (hasExtension(fileName, ".bmp") || hasExtension(fileName, ".tga")) {
+            asset->type = ASSET_TYPE_IMAGE;
+            packed = packImage(&arena, &scratch, asset, fileName);
+        } else {
+            asset->type = ASSET_TYPE_RAW;
+            asset->data = readWholeFile(&arena, fileName, &asset->size);
+            packed = asset->data != NULL;
+        }
+        if (!packed) {
+            return 1;
+        }
+    }
+
+    u32 slotCount = 1;
+    while (slotCount < 2*assetCount) {
+        slotCount <<= 1;
+    }
+    AssetPackEntry* slots     = pushCount(&arena, AssetPackEntry, slotCount);
+    const char**    slotNames = pushCount(&arena, const char*, slotCount);
+    ASSERT(slots != NULL && slotNames != NULL);
+    memset(slots, 0, slotCount*sizeof(AssetPackEntry));
+
+    AssetPackHeader header = {};
+    header.magic       = ASSET_PACK_MAGIC;
+    header.version     = ASSET_PACK_VERSION;
+    header.entryCount  = assetCount;
+    header.slotCount   = slotCount;
+    header.slotsOffset = ASSET_PACK_ALIGNMENT;
+
+    u64 namesOffset = header.slotsOffset + slotCount*sizeof(AssetPackEntry);
+    u64 offset      = namesOffset;
+    for (u32 i = 0; i < assetCount; i++) {
+        offset += strlen(assets[i].name);
+    }
+
+    u64 nameOffset = namesOffset;
+    for (u32 i = 0; i < assetCount; i++) {
+        PackedAsset* asset = &assets[i];
+        offset = (offset + ASSET_PACK_ALIGNMENT - 1) & ~(ASSET_PACK_ALIGNMENT - 1);
+        asset->offset = offset;
+        offset += asset->size;
+
+        u64 hash = hashAssetName(asset->name);
+        u32 mask = slotCount - 1;
+        u32 slot = (u32)hash & mask;
+        while (slots[slot].nameHash != 0) {
+            if (slots[slot].nameHash == hash && strcmp(slotNames[slot], asset->name) == 0) {
+                LOG("Asset %s is listed twice\n", asset->name);
+                return 1;
+            }
+            slot = (slot + 1) & mask;
+        }
+        u32 nameLength = (u32)strlen(asset->name);
+        slots[slot] = (AssetPackEntry){
+            .nameHash   = hash,
+            .nameOffset = nameOffset,
+            .offset     = asset->offset,
+            .size       = asset->size,
+            .type       = asset->type,
+            .nameLength = nameLength,
+        };
+        slotNames[slot] = asset->name;
+        nameOffset += nameLength;
+    }
+    header.fileSize = offset;
+
+    FILE* file;
+    if (fopen_s(&file, outputFileName, "wb") != 0) {
+        LOG("Error opening %s\n", outputFileName);
+        return 1;
+    }
+
+    u64 written = 0;
+    fwrite(&header, sizeof(header), 1, file);
+    written += sizeof(header);
+    writePadding(file, &written, ASSET_PACK_ALIGNMENT);
+    fwrite(slots, sizeof(AssetPackEntry), slotCount, file);
+    written += slotCount*sizeof(AssetPackEntry);
+    for (u32 i = 0; i < assetCount; i++) {
+        usize nameLength = strlen(assets[i].name);
+        fwrite(assets[i].name, 1, nameLength, file);
+        written += nameLength;
+    }
+    for (u32 i = 0; i < assetCount; i++) {
+        writePadding(file, &written, ASSET_PACK_ALIGNMENT);
+        ASSERT(written == assets[i].offset);
+        fwrite(assets[i].data, 1, assets[i].size, file);
+        written += assets[i].size;
+    }
+    ASSERT(written == header.fileSize);
+    fclose(file);
+
+    LOG("Packed %u assets into %s (%llu bytes)\n", assetCount, outputFileName, (unsigned long long)written);
+
+    return 0;
+}
@@ -81,6 +81,34 @@ static double max(double a, double b) {
     return a > b ? a : b;
 } 
 
+static u32 popCount(u64 x) {
+    return (u32)__builtin_popcountll(x);
+}
+
+static u32 countTrailingZeros(u64 x) {
+    return (u32)__builtin_ctzll(x);
+}
+
+// xorshift32, state must not be 0
+static u32 randomU32(u32* state) {
+    u32 x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+// [0, 1)
+static float randomUnilateral(u32* state) {
+    return (randomU32(state) >> 8) * (1.0f / 16777216.0f);
+}
+
+// [-1, 1)
+static float randomBilateral(u32* state) {
+    return 2.0f*randomUnilateral(state) - 1.0f;
+}
+
 #define KB(bytes) ((isize)(bytes) << 10)
 #define MB(bytes) (     KB(bytes) << 10)
 #define GB(bytes) (     MB(bytes) << 10)
@@ -0,0 +1,190 @@
+// Headless batch runner: steps many independent games in parallel on all
+// cores, each driven by a scripted paddle, and reports throughput and
+// level balance numbers.
+//
+// usage: batch_sim [games] [threads] [max game seconds per game]
+//
+// Every game is seeded from its index, so results do not depend on the
+// thread count.
+
+#include "game.h"
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+static constexpr LONG GAMES_PER_CLAIM = 16;
+static constexpr u32  MAX_WORKERS     = 64;
+
+// Follows the ball and tries to catch it at a random spot of the paddle,
+// picking a new spot after every hit.
+struct PaddleAI {
+    u32   random;
+    float aimOffset;
+    float deadZone;
+};
+
+static void pickAimOffset(PaddleAI* ai, GameState* game) {
+    ai->aimOffset = 0.8f * game->players[0].halfExtents.x * randomBilateral(&ai->random);
+}
+
+static PlayerInput scriptedInput(PaddleAI* ai, GameState* game) {
+    PlayerInput input = {};
+    if (!game->startedRound) {
+        input.right = true;
+        return input;
+    }
+
+    float dx = game->ball.circle.center.x - (game->players[0].center.x + ai->aimOffset);
+    if (dx > ai->deadZone) {
+        input.right = true;
+    } else if (dx < -ai->deadZone) {
+        input.left = true;
+    }
+    return input;
+}
+
+struct BatchJob {
+    u32           gameCount;
+    u64           maxTicks;
+    volatile LONG nextGame;
+};
+
+struct alignas(64) BatchStats {
+    u64 games;
+    u64 cleared;
+    u64 ticks;
+    u64 ticksToClear;
+    u64 ballsLost;
+    u64 tilesDestroyed;
+};
+
+struct BatchWorker {
+    BatchJob*  job;
+    BatchStats stats;
+    HANDLE     thread;
+};
+
+static void runGame(u32 gameIndex, u64 maxTicks, BatchStats* stats) {
+    GameState  game;
+    GameEvents events;
+    gameInit(&game);
+
+    PaddleAI ai = {};
+    ai.random   = (gameIndex + 1) * 2654435761u;
+    ai.random   = ai.random ? ai.random : 1;
+    ai.deadZone = 4.0f;
+    pickAimOffset(&ai, &game);
+
+    int  tileCount = countAliveTiles(&game.tiles);
+    bool cleared   = false;
+    while (game.tick < maxTicks) {
+        events.count = 0;
+        PlayerInput input = scriptedInput(&ai, &game);
+        gameUpdate(&game, &input, GAME_TICK_SECONDS, &events);
+
+        bool tileDestroyed = false;
+        for (u32 i = 0; i < events.count; i++) {
+            if (events.events[i].type == GAME_EVENT_PADDLE_HIT) {
+                pickAimOffset(&ai, &game);
+            } else if (events.events[i].type == GAME_EVENT_TILE_DESTROYED) {
+                tileDestroyed = true;
+            }
+        }
+        if (tileDestroyed && countAliveTiles(&game.tiles) == 0) {
+            cleared = true;
+            break;
+        }
+    }
+
+    stats->games++;
+    stats->ticks          += game.tick;
+    stats->ballsLost      += game.ballsLost;
+    stats->tilesDestroyed += tileCount - countAliveTiles(&game.tiles);
+    if (cleared) {
+        stats->cleared++;
+        stats->ticksToClear += game.tick;
+    }
+}
+
+static DWORD WINAPI batchWorkerProc(LPVOID param) {
+    BatchWorker* worker = (BatchWorker*)param;
+    BatchJob*    job    = worker->job;
+    for (;;) {
+        LONG first = InterlockedExchangeAdd(&job->nextGame, GAMES_PER_CLAIM);
+        if ((u32)first >= job->gameCount) {
+            break;
+        }
+        u32 last = min((i64)first + GAMES_PER_CLAIM, (i64)job->gameCount);
+        for (u32 i = (u32)first; i < last; i++) {
+            runGame(i, job->maxTicks, &worker->stats);
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+
+    u32   gameCount   = argc > 1 ? (u32)atoi(argv[1]) : 10000;
+    u32   threadCount = argc > 2 ? (u32)atoi(argv[2]) : systemInfo.dwNumberOfProcessors;
+    float maxSeconds  = argc > 3 ? (float)atof(argv[3]) : 300.0f;
+    if (gameCount == 0 || threadCount == 0 || maxSeconds <= 0) {
+        LOG("usage: %s [games] [threads] [max game seconds per game]\n", argv[0]);
+        return 1;
+    }
+    threadCount = min((i64)threadCount, (i64)MAX_WORKERS);
+
+    BatchJob job = {};
+    job.gameCount = gameCount;
+    job.maxTicks  = (u64)(maxSeconds / GAME_TICK_SECONDS);
+    job.nextGame  = 0;
+
+    static BatchWorker workers[MAX_WORKERS];
+
+    i64 frequency, startTimeStamp, endTimeStamp;
+    QueryPerformanceFrequency((LARGE_INTEGER*)&frequency);
+    QueryPerformanceCounter((LARGE_INTEGER*)&startTimeStamp);
+
+    HANDLE threads[MAX_WORKERS];
+    for (u32 i = 0; i < threadCount; i++) {
+        workers[i].job    = &job;
+        workers[i].stats  = {};
+        workers[i].thread = CreateThread(NULL, 0, batchWorkerProc, &workers[i], 0, NULL);
+        ASSERT(workers[i].thread != NULL);
+        threads[i] = workers[i].thread;
+    }
+    WaitForMultipleObjects(threadCount, threads, TRUE, INFINITE);
+
+    QueryPerformanceCounter((LARGE_INTEGER*)&endTimeStamp);
+    double seconds = (double)(endTimeStamp - startTimeStamp) / frequency;
+
+    BatchStats total = {};
+    for (u32 i = 0; i < threadCount; i++) {
+        BatchStats* stats = &workers[i].stats;
+        total.games          += stats->games;
+        total.cleared        += stats->cleared;
+        total.ticks          += stats->ticks;
+        total.ticksToClear   += stats->ticksToClear;
+        total.ballsLost      += stats->ballsLost;
+        total.tilesDestroyed += stats->tilesDestroyed;
+        CloseHandle(workers[i].thread);
+    }
+    ASSERT(total.games == gameCount);
+
+    double games = (double)total.games;
+    printf("games       %llu on %u threads, %.0f s of game time max\n",
+           (unsigned long long)total.games, threadCount, maxSeconds);
+    printf("wall time   %.3f s\n", seconds);
+    printf("throughput  %.1f games/s, %.2f M ticks/s\n",
+           games / seconds, total.ticks / seconds / 1e6);
+    printf("cleared     %.1f%%", 100.0 * total.cleared / games);
+    if (total.cleared) {
+        printf(", %.1f s of game time on average", total.ticksToClear * GAME_TICK_SECONDS / total.cleared);
+    }
+    printf("\n");
+    printf("balls lost  %.2f per game\n", total.ballsLost / games);
+    printf("tiles       %.2f destroyed per game\n", total.tilesDestroyed / games);
+
+    return 0;
+}
@@ -1,19 +1,35 @@
 #ifndef BREAKOUT_WIN32_H_
 #define BREAKOUT_WIN32_H_
 
-#include "audio.h"
+#include "asset_pack.h"
+#include "capture.h"
+#include "rewind.h"
+#include "rollback.h"
 #define WIN32_LEAN_AND_MEAN
 #define WIN32_EXTRA_LEAN
 #include <Windows.h>
 #include <wingdi.h>
 #include <winuser.h>
 
+// Fixed WIDTH x HEIGHT target the game renders into, independent of the window size
 struct win32_RenderBackBuffer {
     Bitmap bitmap;
-    BITMAPINFO info;
 };
 static win32_RenderBackBuffer g_backBuffer;
 
+// Window sized buffer the back buffer is scaled into before it is handed to
+// GDI. It is allocated for the whole desktop up front so resizing the window
+// only recomputes the layout.
+struct win32_OutputBuffer {
+    Bitmap      bitmap;
+    BITMAPINFO  info;
+    ScaleLayout layout;
+    u32*        columnMap;
+    usize       capacity;
+    u32         maxWidth;
+};
+static win32_OutputBuffer g_outputBuffer;
+
 struct win32_Window {
     HWND handle;
     u32 width;
@@ -21,45 +37,80 @@ struct win32_Window {
 };
 static win32_Window g_window;
 
-static void win32_resizeBackBuffer(u32 width, u32 height) {
-    if ((width == 0 || height == 0) ||
-        (width == g_backBuffer.bitmap.width && height == g_backBuffer.bitmap.height)) {
+static void win32_createBackBuffer(u32 width, u32 height) {
+    g_backBuffer = {};
+    g_backBuffer.bitmap.width  = width;
+    g_backBuffer.bitmap.height = height;
+    g_backBuffer.bitmap.data   = (u32*)malloc(sizeof(u32) * width*height);
+    ASSERT(g_backBuffer.bitmap.data != NULL);
+}
+
+static void win32_resizeOutputBuffer(u32 width, u32 height) {
+    if (width == 0 || height == 0) {
         return;
     }
 
-    if (g_backBuffer.bitmap.data) {
-        free(g_backBuffer.bitmap.data);
+    if ((usize)width*height > g_outputBuffer.capacity || width > g_outputBuffer.maxWidth) {
+        // only happens when the window grows past the desktop size seen at startup
+        if (g_outputBuffer.bitmap.data) {
+            VirtualFree(g_outputBuffer.bitmap.data, 0, MEM_RELEASE);
+        }
+        g_outputBuffer.maxWidth = width > g_outputBuffer.maxWidth ? width : g_outputBuffer.maxWidth;
+        g_outputBuffer.capacity = (usize)width*height > g_outputBuffer.capacity ? (usize)width*height : g_outputBuffer.capacity;
+        g_outputBuffer.bitmap.data = (u32*)VirtualAlloc(NULL, sizeof(u32) * (g_outputBuffer.capacity + g_outputBuffer.maxWidth),
+                                                        MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE);
+        ASSERT(g_outputBuffer.bitmap.data != NULL);
+        g_outputBuffer.columnMap = g_outputBuffer.bitmap.data + g_outputBuffer.capacity;
     }
-    g_backBuffer.bitmap.width  = width;
-    g_backBuffer.bitmap.height = height;
-    g_backBuffer.info.bmiHeader.biWidth  = width;
-    g_backBuffer.info.bmiHeader.biHeight = -height;
-    g_backBuffer.bitmap.data = (u32*)malloc(sizeof(u32) * width*height);
+
+    g_outputBuffer.bitmap.width  = width;
+    g_outputBuffer.bitmap.height = height;
+    g_outputBuffer.info.bmiHeader.biWidth  = width;
+    g_outputBuffer.info.bmiHeader.biHeight = -(LONG)height;
+    computeScaleLayout(&g_outputBuffer.layout, g_backBuffer.bitmap.width, g_backBuffer.bitmap.height,
+                       width, height, g_outputBuffer.columnMap);
+}
+
+static void win32_createOutputBuffer(u32 maxWidth, u32 maxHeight) {
+    g_outputBuffer = {};
+    g_outputBuffer.info.bmiHeader.biSize = sizeof(g_outputBuffer.info.bmiHeader);
+    g_outputBuffer.info.bmiHeader.biPlanes = 1;
+    g_outputBuffer.info.bmiHeader.biBitCount = 32;
+    g_outputBuffer.info.bmiHeader.biCompression = BI_RGB;
+
+    win32_resizeOutputBuffer(maxWidth, maxHeight);
 }
 
+// Held while the output buffer is resized or presented, which happen on
+// different threads in pipelined mode
+static CRITICAL_SECTION g_presentLock;
+
 static void win32_resizeWindow(u32 width, u32 height) {
+    EnterCriticalSection(&g_presentLock);
     g_window.width  = width;
     g_window.height = height;
-    win32_resizeBackBuffer(width, height);
+    win32_resizeOutputBuffer(width, height);
+    LeaveCriticalSection(&g_presentLock);
 }
 
-static void win32_createBackBuffer(u32 width, u32 height) {
-    g_backBuffer = {};
-    g_backBuffer.info.bmiHeader.biSize = sizeof(g_backBuffer.info.bmiHeader);
-    g_backBuffer.info.bmiHeader.biPlanes = 1;
-    g_backBuffer.info.bmiHeader.biBitCount = 32;
-    g_backBuffer.info.bmiHeader.biCompression = BI_RGB;
-
-    win32_resizeBackBuffer(width, height);
-}
+// Cleared on the window thread, polled by the render thread
+static volatile LONG g_running = 1;
 
-struct PlayerInput {
-    bool left;
-    bool right;
-    bool a;
-    bool d;
-};
 static PlayerInput playerInput;
+static bool        g_rewinding = false;
+
+// F3, F4 and F5 flip these on the window thread. The thread that renders
+// copies them into the scene flags at the start of each frame.
+static volatile LONG g_showPerfHud        = 0;
+static volatile LONG g_indexedRequested   = 0;
+static volatile LONG g_antiAliasRequested = 0;
+
+// F9 and F10 ask for a Y4M or raw RGBA capture to start or stop, 1 + CaptureFormat.
+// Whichever thread renders picks the request up.
+static volatile LONG g_captureRequest = 0;
+
+// When the oldest movement key change no tick has consumed yet was handled, 0 when there is none
+static i64 g_inputTimeStamp = 0;
 
 LRESULT WINAPI
 win32_windowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
@@ -79,7 +130,24 @@ win32_windowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
             playerInput.a = isPressed;
         } else if (vkCode == 'D') {
             playerInput.d = isPressed;
+        } else if (vkCode == 'R') {
+            g_rewinding = isPressed;
         } else if (vkCode == 'K' && isPressed) {
+        } else if (vkCode == VK_F3 && isPressed && !(keyFlags & KF_REPEAT)) {
+            InterlockedXor(&g_showPerfHud, 1);
+        } else if (vkCode == VK_F4 && isPressed && !(keyFlags & KF_REPEAT)) {
+            InterlockedXor(&g_indexedRequested, 1);
+        } else if (vkCode == VK_F5 && isPressed && !(keyFlags & KF_REPEAT)) {
+            InterlockedXor(&g_antiAliasRequested, 1);
+        } else if (vkCode == VK_F9 && isPressed && !(keyFlags & KF_REPEAT)) {
+            InterlockedExchange(&g_captureRequest, 1 + CAPTURE_Y4M);
+        } else if (vkCode == VK_F10 && isPressed && !(keyFlags & KF_REPEAT)) {
+            InterlockedExchange(&g_captureRequest, 1 + CAPTURE_RGBA);
+        }
+
+        bool movementKey = vkCode == VK_LEFT || vkCode == VK_RIGHT || vkCode == 'A' || vkCode == 'D';
+        if (movementKey && !(keyFlags & KF_REPEAT) && g_inputTimeStamp == 0) {
+            QueryPerformanceCounter((LARGE_INTEGER*)&g_inputTimeStamp);
         }
     } break;
     case WM_SIZE: {
@@ -88,7 +156,7 @@ win32_windowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
         win32_resizeWindow(width, height);
     } break;
     case WM_DESTROY: {
-        g_running = false;
+        InterlockedExchange(&g_running, 0);
     } break;
     default:
         return DefWindowProcW(hWnd, uMsg, wParam, lParam);
@@ -96,18 +164,334 @@ win32_windowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
     return 0;
 }
 
+static bool win32_mapAssetPack(AssetPack* pack, const char* fileName) {
+    HANDLE file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        LOG("Error opening %s\n", fileName);
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(file, &fileSize);
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (mapping == NULL) {
+        LOG("Error mapping %s\n", fileName);
+        return false;
+    }
+
+    // the view keeps the mapping alive after its handle is closed
+    void* memory = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!assetPackOpen(pack, memory, (usize)fileSize.QuadPart)) {
+        if (memory) {
+            UnmapViewOfFile(memory);
+        }
+        return false;
+    }
+    return true;
+}
+
+static void win32_unmapAssetPack(AssetPack* pack) {
+    if (pack->memory) {
+        UnmapViewOfFile(pack->memory);
+    }
+    *pack = {};
+}
+
 static void win32_blitToWindow() {
+    EnterCriticalSection(&g_presentLock);
+    if (g_window.width == 0 || g_window.height == 0) {
+        LeaveCriticalSection(&g_presentLock);
+        return;
+    }
+
+    Bitmap* output = &g_outputBuffer.bitmap;
+    presentScaled(&g_backBuffer.bitmap, output, &g_outputBuffer.layout);
+
     HDC deviceContext = GetDC(g_window.handle);
     StretchDIBits(deviceContext, 
-                  0, 0, g_window.width, g_window.height, 
-                  0, 0, g_backBuffer.bitmap.width, g_backBuffer.bitmap.height,
-                  g_backBuffer.bitmap.data, &g_backBuffer.info, 
+                  0, 0, output->width, output->height, 
+                  0, 0, output->width, output->height,
+                  output->data, &g_outputBuffer.info, 
                   DIB_RGB_COLORS, SRCCOPY);
     ReleaseDC(g_window.handle, deviceContext);
+    LeaveCriticalSection(&g_presentLock);
+}
+
+#define WIN32_CAPTURE_FRAME_RATE 60
+
+// Only touched by the thread that renders
+struct win32_Capture {
+    CaptureContext* context;
+    CaptureFormat   format;
+    u32             fileIndex;
+    float           untilNextFrame;
+};
+static win32_Capture g_capture;
+
+static void win32_handleCaptureRequest() {
+    LONG request = InterlockedExchange(&g_captureRequest, 0);
+    if (!request) {
+        return;
+    }
+
+    CaptureFormat format = (CaptureFormat)(request - 1);
+    bool stopOnly = g_capture.context && g_capture.format == format;
+    if (g_capture.context) {
+        // the writer finishes the file in the background
+        captureStop(g_capture.context, false);
+        g_capture.context = NULL;
+    }
+    if (stopOnly) {
+        return;
+    }
+
+    char fileName[64];
+    snprintf(fileName, sizeof(fileName), "capture_%u.%s", g_capture.fileIndex++,
+             format == CAPTURE_Y4M ? "y4m" : "rgba");
+    g_capture.context = captureStart(fileName, format, g_backBuffer.bitmap.width, g_backBuffer.bitmap.height,
+                                     WIN32_CAPTURE_FRAME_RATE);
+    g_capture.format         = format;
+    g_capture.untilNextFrame = 0;
+}
+
+// Submits the back buffer at a fixed rate regardless of how fast frames are
+// rendered, slow frames are repeated so the video keeps real time.
+static void win32_captureFrame(float deltaSeconds) {
+    if (!g_capture.context) {
+        return;
+    }
+
+    g_capture.untilNextFrame -= deltaSeconds;
+    for (u32 repeats = 0; g_capture.untilNextFrame <= 0 && repeats < 4; repeats++) {
+        captureSubmit(g_capture.context, &g_backBuffer.bitmap);
+        g_capture.untilNextFrame += 1.0f / WIN32_CAPTURE_FRAME_RATE;
+    }
+    // after a long hitch start over instead of catching up
+    if (g_capture.untilNextFrame <= 0) {
+        g_capture.untilNextFrame = 1.0f / WIN32_CAPTURE_FRAME_RATE;
+    }
+
+    CaptureStats stats = captureGetStats(g_capture.context);
+    pushTextF(textBatch, font, vec2(WIDTH - 300, 12), 0xffff4040, "REC %llu DROPPED %llu",
+              (unsigned long long)stats.submitted, (unsigned long long)stats.dropped);
+    flushText(textBatch, font, &g_backBuffer.bitmap);
+}
+
+struct win32_FrameTimes {
+    i64 renderStart;
+    i64 presentStart;
+    i64 presentEnd;
+};
+
+static win32_FrameTimes win32_renderFrame(GameState* game, GameEvents* events, float deltaSeconds,
+                                          PerfStats* perfStats) {
+    win32_FrameTimes times;
+    QueryPerformanceCounter((LARGE_INTEGER*)&times.renderStart);
+    g_indexedRendering = InterlockedCompareExchange(&g_indexedRequested, 0, 0) != 0;
+    g_antiAliasing     = InterlockedCompareExchange(&g_antiAliasRequested, 0, 0) != 0;
+    updateEffects(events, deltaSeconds);
+    render(game, &g_backBuffer.bitmap);
+    // captured before any overlay is drawn on top
+    win32_handleCaptureRequest();
+    win32_captureFrame(deltaSeconds);
+    if (InterlockedCompareExchange(&g_showPerfHud, 0, 0)) {
+        drawPerfHud(perfStats, textBatch, font, &g_backBuffer.bitmap);
+    }
+    QueryPerformanceCounter((LARGE_INTEGER*)&times.presentStart);
+    win32_blitToWindow();
+    QueryPerformanceCounter((LARGE_INTEGER*)&times.presentEnd);
+    return times;
+}
+
+// Everything the render thread needs to draw a frame, copied out of the
+// simulation so neither thread waits on the other.
+struct win32_FrameSnapshot {
+    GameState game;
+    i64       inputTimeStamp; // 0 when no new input went into this snapshot
+    float     simMs;
+    float     mixMs;
+    char      status[sizeof(PerfStats::status)];
+};
+
+#define WIN32_SNAPSHOT_FRESH 4
+
+// Triple buffer: the simulation fills back, then swaps it with middle. The
+// render thread swaps front with middle whenever middle is fresh, so it
+// always draws the latest published snapshot and never blocks the writer.
+struct win32_SnapshotBuffer {
+    win32_FrameSnapshot* snapshots;
+    volatile LONG        middle;     // snapshot index, | WIN32_SNAPSHOT_FRESH until the render thread takes it
+    u32                  back;
+    u32                  front;
+    bool                 backUnseen; // back was published but replaced before it was rendered
+    HANDLE               published;
+};
+
+// Snapshots can be skipped, so game events reach the render thread through
+// a single producer, single consumer ring instead. Events are dropped when
+// it is full.
+#define WIN32_EVENT_RING_SIZE 256
+
+struct win32_EventRing {
+    GameEvent     events[WIN32_EVENT_RING_SIZE];
+    volatile LONG writeIndex;
+    volatile LONG readIndex;
+};
+
+static void win32_pushEvents(win32_EventRing* ring, GameEvents* events) {
+    LONG write = ring->writeIndex;
+    for (u32 i = 0; i < events->count; i++) {
+        if ((u32)(write - ring->readIndex) == WIN32_EVENT_RING_SIZE) {
+            break;
+        }
+        ring->events[write % WIN32_EVENT_RING_SIZE] = events->events[i];
+        write++;
+    }
+    InterlockedExchange(&ring->writeIndex, write);
+}
+
+static void win32_popEvents(win32_EventRing* ring, GameEvents* events) {
+    events->count = 0;
+    LONG read  = ring->readIndex;
+    LONG write = ring->writeIndex;
+    while (read != write && events->count < MAX_GAME_EVENTS) {
+        events->events[events->count++] = ring->events[read % WIN32_EVENT_RING_SIZE];
+        read++;
+    }
+    InterlockedExchange(&ring->readIndex, read);
+}
+
+static bool win32_createSnapshotBuffer(win32_SnapshotBuffer* buffer, Arena* arena) {
+    *buffer = {};
+    buffer->snapshots = pushCount(arena, win32_FrameSnapshot, 3);
+    buffer->published = CreateEventA(NULL, FALSE, FALSE, NULL);
+    if (!buffer->snapshots || !buffer->published) {
+        return false;
+    }
+    memset(buffer->snapshots, 0, 3 * sizeof(win32_FrameSnapshot));
+    buffer->back   = 0;
+    buffer->middle = 1;
+    buffer->front  = 2;
+    return true;
+}
+
+static win32_FrameSnapshot* win32_backSnapshot(win32_SnapshotBuffer* buffer) {
+    return &buffer->snapshots[buffer->back];
+}
+
+static void win32_publishSnapshot(win32_SnapshotBuffer* buffer) {
+    LONG previous = InterlockedExchange(&buffer->middle, buffer->back | WIN32_SNAPSHOT_FRESH);
+    buffer->back       = previous & 3;
+    buffer->backUnseen = (previous & WIN32_SNAPSHOT_FRESH) != 0;
+    SetEvent(buffer->published);
+}
+
+// Returns NULL when nothing new was published since the last call
+static win32_FrameSnapshot* win32_acquireSnapshot(win32_SnapshotBuffer* buffer) {
+    if (!(buffer->middle & WIN32_SNAPSHOT_FRESH)) {
+        return NULL;
+    }
+    LONG previous = InterlockedExchange(&buffer->middle, buffer->front);
+    buffer->front = previous & 3;
+    return &buffer->snapshots[buffer->front];
+}
+
+struct win32_RenderThread {
+    win32_SnapshotBuffer* snapshots;
+    win32_EventRing*      events;
+    PerfStats*            perfStats;
+    i64                   frequency;
+    HANDLE                handle;
+};
+
+// Owns effects, rendering, present and perfStats while pipelining is on
+static DWORD WINAPI win32_renderThreadProc(LPVOID param) {
+    win32_RenderThread* thread    = (win32_RenderThread*)param;
+    PerfStats*          perfStats = thread->perfStats;
+    float               msPerTick = 1000.0f / thread->frequency;
+
+    i64 lastRenderStart, lastPresentEnd;
+    QueryPerformanceCounter((LARGE_INTEGER*)&lastRenderStart);
+    lastPresentEnd = lastRenderStart;
+    while (InterlockedCompareExchange(&g_running, 0, 0)) {
+        WaitForSingleObject(thread->snapshots->published, INFINITE);
+        win32_FrameSnapshot* snapshot = win32_acquireSnapshot(thread->snapshots);
+        if (!snapshot) {
+            continue;
+        }
+
+        i64 now;
+        QueryPerformanceCounter((LARGE_INTEGER*)&now);
+        float deltaSeconds = (now - lastRenderStart) * msPerTick / 1000.0f;
+        lastRenderStart = now;
+
+        GameEvents events;
+        win32_popEvents(thread->events, &events);
+        memcpy(perfStats->status, snapshot->status, sizeof(perfStats->status));
+        win32_FrameTimes times = win32_renderFrame(&snapshot->game, &events, deltaSeconds, perfStats);
+
+        perfRecordFrame(perfStats, (times.presentEnd - lastPresentEnd) * msPerTick, snapshot->simMs,
+                        (times.presentStart - times.renderStart) * msPerTick, snapshot->mixMs,
+                        (times.presentEnd - times.presentStart) * msPerTick);
+        if (snapshot->inputTimeStamp) {
+            perfRecordLatency(perfStats, (times.presentEnd - snapshot->inputTimeStamp) * msPerTick);
+        }
+        lastPresentEnd = times.presentEnd;
+    }
+    return 0;
 }
 
-int main() {
+static void win32_formatRollbackStatus(char* status, usize size, RollbackStats* stats) {
+    snprintf(status, size, "ROLLBACK %u TICKS MAX %u STALLS %llu",
+             stats->lastRollbackTicks, stats->maxRollbackTicks, (unsigned long long)stats->stalls);
+}
+
+// Versus mode runs both peers of a rollback session in this process, joined
+// by a loopback link, player 1 on the arrow keys and player 2 on A/D.
+struct win32_Options {
+    bool  versus;
+    bool  pipelined;
+    float latencySeconds;
+    float jitterSeconds;
+    float lossRate;
+};
+
+static win32_Options win32_parseOptions(int argc, char** argv) {
+    win32_Options options = {
+        .latencySeconds = 0.04f,
+        .jitterSeconds  = 0.01f,
+        .lossRate       = 0.05f,
+    };
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--versus") == 0) {
+            options.versus = true;
+        } else if (strcmp(argv[i], "--pipelined") == 0) {
+            options.pipelined = true;
+        } else if (strcmp(argv[i], "--latency") == 0 && hasValue) {
+            options.latencySeconds = (float)atof(argv[++i]) / 1000.0f;
+        } else if (strcmp(argv[i], "--jitter") == 0 && hasValue) {
+            options.jitterSeconds = (float)atof(argv[++i]) / 1000.0f;
+        } else if (strcmp(argv[i], "--loss") == 0 && hasValue) {
+            options.lossRate = (float)atof(argv[++i]) / 100.0f;
+        } else {
+            LOG("Ignoring unknown option %s\n", argv[i]);
+        }
+    }
+    return options;
+}
+
+int main(int argc, char** argv) {
+    win32_Options options = win32_parseOptions(argc, argv);
+    InitializeCriticalSection(&g_presentLock);
+
     {
+        win32_createBackBuffer(WIDTH, HEIGHT);
+        win32_createOutputBuffer(GetSystemMetrics(SM_CXVIRTUALSCREEN), GetSystemMetrics(SM_CYVIRTUALSCREEN));
+
         const wchar_t wndClassName[] = L"WndClassName";
         WNDCLASSEXW wndClass = {};
         wndClass.cbSize        = sizeof(WNDCLASSEXW);
@@ -135,20 +519,18 @@ int main() {
         ASSERT(g_window.handle != NULL);
 
         GetClientRect(g_window.handle, &rect);
-        g_window.width  = rect.right;
-        g_window.height = rect.bottom;
-        win32_createBackBuffer(g_window.width, g_window.height);
+        win32_resizeWindow(rect.right, rect.bottom);
 
         ShowWindow(g_window.handle, SW_SHOWDEFAULT);
         UpdateWindow(g_window.handle);
     }
 
     Arena backingMem = {};
-    backingMem.capacity = (usize)MB(16);
+    backingMem.capacity = (usize)MB(32);
     backingMem.memory   = (u8*)VirtualAlloc(NULL, backingMem.capacity, MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE);
     ASSERT(backingMem.memory != NULL);
     Arena permanentMem = {};
-    permanentMem.capacity = (usize)MB(8);
+    permanentMem.capacity = (usize)MB(16);
     permanentMem.memory   = (u8*)allocate(&backingMem, permanentMem.capacity);
     ASSERT(permanentMem.memory != NULL);
     Arena tempMem = {};
@@ -163,9 +545,31 @@ int main() {
 
     AudioContext* audioCtx = audioInit(&audioMem, &tempMem);
 
+    AssetPack assets = {};
+    AudioTrack* woohAudio = NULL;
+    if (win32_mapAssetPack(&assets, "data/assets.pack")) {
+        woohAudio      = assetPackGetSound(&audioMem, &assets, "sounds/wooh.wav");
+        sprites.tile   = assetPackGetBitmap(&permanentMem, &assets, "images/tile.bmp");
+        sprites.paddle = assetPackGetBitmap(&permanentMem, &assets, "images/paddle.bmp");
+        sprites.ball   = assetPackGetBitmap(&permanentMem, &assets, "images/ball.bmp");
+    }
+    // a missing or stale pack falls back per asset
+    if (!woohAudio || !sprites.tile || !sprites.paddle || !sprites.ball) {
+        LOG("Falling back to loose asset files\n");
+    }
     // TODO(pedro s.): Create tempMem frame and reset it after call
-    AudioTrack* woohAudio = readWaveFile(&audioMem, &tempMem, "data/sounds/wooh.wav");
-    (void)woohAudio;
+    if (!woohAudio) {
+        woohAudio = readWaveFile(&audioMem, &tempMem, "data/sounds/wooh.wav");
+    }
+    if (!sprites.tile) {
+        sprites.tile = readImageFile(&permanentMem, &tempMem, "data/images/tile.bmp");
+    }
+    if (!sprites.paddle) {
+        sprites.paddle = readImageFile(&permanentMem, &tempMem, "data/images/paddle.bmp");
+    }
+    if (!sprites.ball) {
+        sprites.ball = readImageFile(&permanentMem, &tempMem, "data/images/ball.bmp");
+    }
 
     struct ActiveSound {
         AudioTrack* track;
@@ -181,18 +585,62 @@ int main() {
         activeSoundIndices[i] = i;
     }
 
-    u32 idx;
-    idx = activeSoundIndices[activeSoundCount++];
-    activeSounds[idx] = (ActiveSound){
-        .track  = woohAudio,
-        .start  = 1.0f,
-        .volume = -5,
-    };
+    if (woohAudio) {
+        u32 idx = activeSoundIndices[activeSoundCount++];
+        activeSounds[idx] = (ActiveSound){
+            .track  = woohAudio,
+            .start  = 1.0f,
+            .volume = -5,
+        };
+    }
     
     float submitAheadSeconds = 0.05f;
 
 
-    gameInit();
+    font      = makeFont(&permanentMem, 2);
+    textBatch = makeTextBatch(&permanentMem, 4096);
+    ASSERT(font != NULL && textBatch != NULL);
+
+    particles = makeParticleSystem(&permanentMem, MAX_PARTICLES);
+    ASSERT(particles != NULL);
+
+    indexedTarget = allocateIndexedBitmap(&permanentMem, WIDTH, HEIGHT);
+    ASSERT(indexedTarget != NULL);
+
+    PerfStats perfStats = {};
+    perfTrackArena(&perfStats, "permanent", &permanentMem);
+    perfTrackArena(&perfStats, "temp", &tempMem);
+    perfTrackArena(&perfStats, "audio", &audioMem);
+
+    GameState  game;
+    GameEvents events;
+    gameInit(&game, options.versus ? 2 : 1);
+
+    LoopbackLink*    links[2]     = {};
+    LoopbackEndpoint endpoints[2] = {};
+    Transport        transports[2];
+    RollbackSession* sessions[2]  = {};
+    if (options.versus) {
+        for (u32 i = 0; i < 2; i++) {
+            links[i] = push(&permanentMem, LoopbackLink);
+            ASSERT(links[i] != NULL);
+            initLoopbackLink(links[i], options.latencySeconds, options.jitterSeconds, options.lossRate, i + 1);
+        }
+        for (u32 i = 0; i < 2; i++) {
+            endpoints[i]  = {.outgoing = links[i], .incoming = links[1 - i]};
+            transports[i] = makeLoopbackTransport(&endpoints[i]);
+            sessions[i]   = makeRollbackSession(&permanentMem, &transports[i], i);
+            ASSERT(sessions[i] != NULL);
+        }
+    }
+
+    constexpr u32 REWIND_SECONDS = 10;
+    u32 rewindTicks = (u32)(REWIND_SECONDS / GAME_TICK_SECONDS) + 1;
+    RewindBuffer* rewind = makeRewindBuffer(&permanentMem, rewindTicks, (u32)KB(512));
+    ASSERT(rewind != NULL);
+    rewindRecord(rewind, &game);
+
+    float tickAccumulator = 0;
 
     float currentTime = 0;
     i64 startTimeStamp;
@@ -202,7 +650,25 @@ int main() {
     QueryPerformanceCounter((LARGE_INTEGER*)&startTimeStamp);
     timeStamp = startTimeStamp;
 
-    while (g_running) {
+    // In pipelined mode this thread handles messages, audio and the
+    // simulation, a second thread renders and presents the latest snapshot.
+    win32_SnapshotBuffer snapshots    = {};
+    win32_EventRing*     eventRing    = NULL;
+    win32_RenderThread   renderThread = {};
+    if (options.pipelined) {
+        bool created = win32_createSnapshotBuffer(&snapshots, &permanentMem);
+        eventRing    = push(&permanentMem, win32_EventRing);
+        ASSERT(created && eventRing != NULL);
+        *eventRing = {};
+        renderThread.snapshots = &snapshots;
+        renderThread.events    = eventRing;
+        renderThread.perfStats = &perfStats;
+        renderThread.frequency = frequency;
+        renderThread.handle    = CreateThread(NULL, 0, win32_renderThreadProc, &renderThread, 0, NULL);
+        ASSERT(renderThread.handle != NULL);
+    }
+
+    while (InterlockedCompareExchange(&g_running, 0, 0)) {
         i64 lastTimeStamp = timeStamp;
         QueryPerformanceCounter((LARGE_INTEGER*)&timeStamp);
         currentTime = (float)(timeStamp - startTimeStamp) / frequency;
@@ -213,11 +679,13 @@ int main() {
             TranslateMessage(&msg);
             DispatchMessageW(&msg);
             if (msg.message == WM_QUIT) {
-                g_running = false;
+                InterlockedExchange(&g_running, 0);
                 break;
             }
         }
 
+        i64 mixStart;
+        QueryPerformanceCounter((LARGE_INTEGER*)&mixStart);
         if (audioCtx->playBackTime <= currentTime + submitAheadSeconds) {
             audioCtx->submittedFrameCount = 0;
             memset(audioCtx->audioMixToSubmit, 0, 2*2*audioCtx->submitAheadFrameCount);
@@ -255,14 +723,106 @@ int main() {
         }
         fillAudioBuffer(audioCtx);
 
-        gameUpdate(deltaSeconds);
-        render();
-        win32_blitToWindow();
+        i64 simStart, simEnd;
+        QueryPerformanceCounter((LARGE_INTEGER*)&simStart);
+        events.count = 0;
+        bool ticked = false;
+        // don't try to catch up after a long stall, e.g. while the window is dragged
+        tickAccumulator = min(tickAccumulator + deltaSeconds, 0.25f);
+        while (tickAccumulator >= GAME_TICK_SECONDS) {
+            tickAccumulator -= GAME_TICK_SECONDS;
+            ticked = true;
+            if (options.versus) {
+                for (u32 i = 0; i < 2; i++) {
+                    advanceLoopbackLink(links[i], GAME_TICK_SECONDS);
+                }
+                PlayerInput player1 = {.left = playerInput.left, .right = playerInput.right};
+                PlayerInput player2 = {.left = playerInput.a, .right = playerInput.d};
+                // only the first peer is shown, so only its effects are played
+                rollbackAdvance(sessions[0], player1, &events);
+                rollbackAdvance(sessions[1], player2, NULL);
+                game = sessions[0]->state;
+            } else if (g_rewinding) {
+                // step back one tick at a time, so rewinding runs at the speed the game was played
+                if (game.tick > rewindOldestTick(rewind)) {
+                    rewindRestore(rewind, game.tick - 1, &game);
+                }
+            } else {
+                // resuming after a rewind overwrites the future that was rewound over
+                rewindTruncate(rewind, game.tick);
+                gameUpdate(&game, &playerInput, GAME_TICK_SECONDS, &events);
+                rewindRecord(rewind, &game);
+            }
+        }
+        QueryPerformanceCounter((LARGE_INTEGER*)&simEnd);
+
+        i64 inputTimeStamp = 0;
+        if (ticked) {
+            inputTimeStamp   = g_inputTimeStamp;
+            g_inputTimeStamp = 0;
+        }
+
+        float msPerTick = 1000.0f / frequency;
+        if (options.pipelined) {
+            if (!ticked) {
+                // nothing new to show yet, leave the core to the render thread
+                SwitchToThread();
+                continue;
+            }
+
+            win32_pushEvents(eventRing, &events);
+
+            win32_FrameSnapshot* snapshot = win32_backSnapshot(&snapshots);
+            // the input of a snapshot that was never rendered is measured with this one instead
+            if (!snapshots.backUnseen) {
+                snapshot->inputTimeStamp = 0;
+            }
+            snapshot->game = game;
+            if (!snapshot->inputTimeStamp) {
+                snapshot->inputTimeStamp = inputTimeStamp;
+            }
+            snapshot->simMs = (simEnd - simStart) * msPerTick;
+            snapshot->mixMs = (simStart - mixStart) * msPerTick;
+            snapshot->status[0] = 0;
+            if (options.versus) {
+                win32_formatRollbackStatus(snapshot->status, sizeof(snapshot->status), &sessions[0]->stats);
+            }
+            win32_publishSnapshot(&snapshots);
+            continue;
+        }
+
+        if (options.versus) {
+            win32_formatRollbackStatus(perfStats.status, sizeof(perfStats.status), &sessions[0]->stats);
+        }
+        win32_FrameTimes times = win32_renderFrame(&game, &events, deltaSeconds, &perfStats);
+
+        perfRecordFrame(&perfStats, deltaSeconds * 1000.0f,
+                        (simEnd - simStart) * msPerTick,
+                        (times.presentStart - times.renderStart) * msPerTick,
+                        (simStart - mixStart) * msPerTick,
+                        (times.presentEnd - times.presentStart) * msPerTick);
+        if (inputTimeStamp) {
+            perfRecordLatency(&perfStats, (times.presentEnd - inputTimeStamp) * msPerTick);
+        }
+    }
+
+    if (options.pipelined) {
+        // g_running is cleared by now, wake the render thread so it sees that
+        SetEvent(snapshots.published);
+        WaitForSingleObject(renderThread.handle, INFINITE);
+        CloseHandle(renderThread.handle);
+        CloseHandle(snapshots.published);
+    }
+    DeleteCriticalSection(&g_presentLock);
+    if (g_capture.context) {
+        captureStop(g_capture.context, true);
     }
 
     free(g_backBuffer.bitmap.data);
+    VirtualFree(g_outputBuffer.bitmap.data, 0, MEM_RELEASE);
 
     audioDeinit(audioCtx);
+    win32_unmapAssetPack(&assets);
 
     return 0;
 }
@@ -0,0 +1,127 @@
+#ifndef BREAKOUT_CAPTURE_H_
+#define BREAKOUT_CAPTURE_H_
+
+#include "render.h"
+
+// Records finished frames to disk without ever waiting on it. captureSubmit
+// copies the frame into a free slot of a fixed ring and returns, a writer
+// thread converts the slots and writes them out in large batches. When the
+// ring is full the frame is dropped and counted instead.
+
+enum CaptureFormat {
+    CAPTURE_Y4M,  // YUV4MPEG2, 4:2:0 BT.601 limited range, plays in ffplay/mpv
+    CAPTURE_RGBA, // headerless R,G,B,A bytes, one frame after another
+};
+
+struct CaptureContext;
+
+struct CaptureStats {
+    u64 submitted;
+    u64 dropped;
+};
+
+CaptureContext* captureStart(const char* fileName, CaptureFormat format, u32 width, u32 height, u32 frameRate);
+// returns false when the frame had to be dropped
+bool captureSubmit(CaptureContext* capture, Bitmap* frame);
+CaptureStats captureGetStats(CaptureContext* capture);
+// The writer thread finishes the queued frames and frees the context on its
+// own, wait only blocks until it did, e.g. on shutdown.
+void captureStop(CaptureContext* capture, bool wait);
+
+static u32 captureFrameSize(CaptureFormat format, u32 width, u32 height) {
+    if (format == CAPTURE_Y4M) {
+        return 6 + width*height + 2 * ((width + 1)/2) * ((height + 1)/2); // "FRAME\n" + planes
+    }
+    return 4 * width*height;
+}
+
+// 0xAARRGGBB to R,G,B,A bytes
+static void convertToRgba(u8* out, u32* pixels, u32 count) {
+    __m128i greenAlpha = _mm_set1_epi32((int)0xff00ff00);
+    __m128i blue       = _mm_set1_epi32(0x000000ff);
+    u32 i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i p = _mm_loadu_si128((__m128i*)(pixels + i));
+        __m128i swapped = _mm_or_si128(_mm_and_si128(p, greenAlpha),
+                                       _mm_or_si128(_mm_slli_epi32(_mm_and_si128(p, blue), 16),
+                                                    _mm_and_si128(_mm_srli_epi32(p, 16), blue)));
+        _mm_storeu_si128((__m128i*)(out + 4*i), swapped);
+    }
+    for (; i < count; i++) {
+        u32 p = pixels[i];
+        u32 swapped = (p & 0xff00ff00) | ((p & 0xff) << 16) | ((p >> 16) & 0xff);
+        memcpy(out + 4*i, &swapped, 4);
+    }
+}
+
+// Y = (66R + 129G + 25B + 128) / 256 + 16, eight pixels at a time
+static void convertRowToLuma(u8* out, u32* pixels, u32 count) {
+    __m128i weights = _mm_setr_epi16(25, 129, 66, 0, 25, 129, 66, 0);
+    __m128i zero    = _mm_setzero_si128();
+    __m128i round   = _mm_set1_epi32(128);
+    __m128i offset  = _mm_set1_epi16(16);
+    u32 i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i sums[2];
+        for (u32 half = 0; half < 2; half++) {
+            __m128i p  = _mm_loadu_si128((__m128i*)(pixels + i + 4*half));
+            // per pixel: (25B + 129G, 66R + 0A) as two 32-bit lanes
+            __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(p, zero), weights);
+            __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(p, zero), weights);
+            __m128i a  = _mm_shuffle_epi32(lo, _MM_SHUFFLE(3, 1, 2, 0));
+            __m128i b  = _mm_shuffle_epi32(hi, _MM_SHUFFLE(3, 1, 2, 0));
+            __m128i y  = _mm_add_epi32(_mm_unpacklo_epi64(a, b), _mm_unpackhi_epi64(a, b));
+            sums[half] = _mm_srli_epi32(_mm_add_epi32(y, round), 8);
+        }
+        __m128i luma = _mm_add_epi16(_mm_packs_epi32(sums[0], sums[1]), offset);
+        _mm_storel_epi64((__m128i*)(out + i), _mm_packus_epi16(luma, luma));
+    }
+    for (; i < count; i++) {
+        u32 p = pixels[i];
+        u32 r = (p >> 16) & 0xff, g = (p >> 8) & 0xff, b = p & 0xff;
+        out[i] = (u8)(((66*r + 129*g + 25*b + 128) >> 8) + 16);
+    }
+}
+
+// Writes a Y4M FRAME: the marker, the full resolution Y plane, then U and V
+// subsampled over 2x2 blocks. pitch is in pixels.
+static void convertToY4mFrame(u8* out, u32* pixels, u32 width, u32 height, u32 pitch) {
+    memcpy(out, "FRAME\n", 6);
+    u8* lumaPlane = out + 6;
+    u32 chromaWidth  = (width + 1) / 2;
+    u32 chromaHeight = (height + 1) / 2;
+    u8* uPlane = lumaPlane + width*height;
+    u8* vPlane = uPlane + chromaWidth*chromaHeight;
+
+    for (u32 y = 0; y < height; y++) {
+        convertRowToLuma(lumaPlane + y*width, pixels + y*pitch, width);
+    }
+
+    for (u32 cy = 0; cy < chromaHeight; cy++) {
+        u32* row0 = pixels + (2*cy) * pitch;
+        u32* row1 = 2*cy + 1 < height ? row0 + pitch : row0;
+        for (u32 cx = 0; cx < chromaWidth; cx++) {
+            u32 x0 = 2*cx;
+            u32 x1 = x0 + 1 < width ? x0 + 1 : x0;
+            u32 quad[4] = {row0[x0], row0[x1], row1[x0], row1[x1]};
+            i32 r = 0, g = 0, b = 0;
+            for (u32 k = 0; k < 4; k++) {
+                r += (quad[k] >> 16) & 0xff;
+                g += (quad[k] >> 8) & 0xff;
+                b += quad[k] & 0xff;
+            }
+            r = (r + 2) >> 2;
+            g = (g + 2) >> 2;
+            b = (b + 2) >> 2;
+            uPlane[cy*chromaWidth + cx] = (u8)(((-38*r - 74*g + 112*b + 128) >> 8) + 128);
+            vPlane[cy*chromaWidth + cx] = (u8)(((112*r - 94*g - 18*b + 128) >> 8) + 128);
+        }
+    }
+}
+
+static u32 formatY4mHeader(char* out, u32 capacity, u32 width, u32 height, u32 frameRate) {
+    int length = snprintf(out, capacity, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg\n", width, height, frameRate);
+    return length > 0 ? (u32)length : 0;
+}
+
+#endif // BREAKOUT_CAPTURE_H_
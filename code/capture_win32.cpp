@@ -0,0 +1,184 @@
+#include "capture.h"
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+static constexpr u32   CAPTURE_SLOT_COUNT  = 8;
+// converted frames are collected until at least this much can go out in one WriteFile
+static constexpr usize CAPTURE_BATCH_BYTES = (usize)MB(8);
+
+struct CaptureContext {
+    CaptureFormat format;
+    u32           width;
+    u32           height;
+    u32           frameRate;
+    char          fileName[260];
+    HANDLE        file;
+
+    // Ring of raw frame copies. The submitting thread only advances
+    // writeIndex, the writer thread only advances readIndex.
+    u32*          slots;
+    volatile LONG writeIndex;
+    volatile LONG readIndex;
+    HANDLE        framesQueued;
+
+    u8*           batch;
+    usize         batchSize;
+    usize         batchCapacity;
+
+    volatile LONG stopping;
+    // held by the writer thread and by whoever calls captureStop, the last one frees the context
+    volatile LONG references;
+    HANDLE        thread;
+    u64           submitted;
+    u64           dropped;
+    u64           written;
+};
+
+static u32* captureSlot(CaptureContext* capture, LONG index) {
+    return capture->slots + (usize)(index % CAPTURE_SLOT_COUNT) * capture->width*capture->height;
+}
+
+static void captureRelease(CaptureContext* capture) {
+    if (InterlockedDecrement(&capture->references) == 0) {
+        CloseHandle(capture->framesQueued);
+        VirtualFree(capture, 0, MEM_RELEASE);
+    }
+}
+
+static bool captureFlush(CaptureContext* capture) {
+    u8*   data = capture->batch;
+    usize size = capture->batchSize;
+    capture->batchSize = 0;
+    while (size > 0) {
+        DWORD chunk = (DWORD)(size < (usize)MB(64) ? size : (usize)MB(64));
+        DWORD written = 0;
+        if (!WriteFile(capture->file, data, chunk, &written, NULL) || written == 0) {
+            LOG("Error writing to %s\n", capture->fileName);
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+static DWORD WINAPI captureWriterProc(LPVOID param) {
+    CaptureContext* capture   = (CaptureContext*)param;
+    u32             frameSize = captureFrameSize(capture->format, capture->width, capture->height);
+    bool            ok        = true;
+
+    if (capture->format == CAPTURE_Y4M) {
+        capture->batchSize = formatY4mHeader((char*)capture->batch, (u32)capture->batchCapacity,
+                                             capture->width, capture->height, capture->frameRate);
+    }
+
+    for (;;) {
+        WaitForSingleObject(capture->framesQueued, INFINITE);
+        bool stopping = capture->stopping != 0;
+
+        while (capture->readIndex != capture->writeIndex) {
+            if (capture->batchSize + frameSize > capture->batchCapacity) {
+                ok = ok && captureFlush(capture);
+                capture->batchSize = 0;
+            }
+
+            u32* pixels = captureSlot(capture, capture->readIndex);
+            u8*  out    = capture->batch + capture->batchSize;
+            if (capture->format == CAPTURE_Y4M) {
+                convertToY4mFrame(out, pixels, capture->width, capture->height, capture->width);
+            } else {
+                convertToRgba(out, pixels, capture->width*capture->height);
+            }
+            capture->batchSize += frameSize;
+            capture->written++;
+            // the slot is free again as soon as it is converted
+            InterlockedIncrement(&capture->readIndex);
+        }
+
+        if (stopping) {
+            break;
+        }
+    }
+
+    ok = ok && captureFlush(capture);
+    CloseHandle(capture->file);
+    LOG("Captured %llu frames to %s, %llu dropped%s\n", (unsigned long long)capture->written,
+        capture->fileName, (unsigned long long)capture->dropped, ok ? "" : ", the file is incomplete");
+    captureRelease(capture);
+    return 0;
+}
+
+CaptureContext* captureStart(const char* fileName, CaptureFormat format, u32 width, u32 height, u32 frameRate) {
+    usize frameSize     = captureFrameSize(format, width, height);
+    usize slotsSize     = (usize)CAPTURE_SLOT_COUNT * sizeof(u32) * width*height;
+    usize batchCapacity = frameSize > CAPTURE_BATCH_BYTES ? frameSize : CAPTURE_BATCH_BYTES;
+    batchCapacity += 256; // room for the stream header
+
+    // one allocation for the whole session, released by the writer thread
+    u8* memory = (u8*)VirtualAlloc(NULL, sizeof(CaptureContext) + slotsSize + batchCapacity,
+                                   MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE);
+    if (!memory) {
+        LOG("Not enough memory to capture\n");
+        return NULL;
+    }
+
+    CaptureContext* capture = (CaptureContext*)memory;
+    *capture = {};
+    capture->format        = format;
+    capture->width         = width;
+    capture->height        = height;
+    capture->frameRate     = frameRate;
+    capture->slots         = (u32*)(memory + sizeof(CaptureContext));
+    capture->batch         = memory + sizeof(CaptureContext) + slotsSize;
+    capture->batchCapacity = batchCapacity;
+    capture->references    = 2;
+    snprintf(capture->fileName, sizeof(capture->fileName), "%s", fileName);
+
+    capture->file = CreateFileA(fileName, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                                FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (capture->file == INVALID_HANDLE_VALUE) {
+        LOG("Error creating %s\n", fileName);
+        VirtualFree(memory, 0, MEM_RELEASE);
+        return NULL;
+    }
+
+    capture->framesQueued = CreateSemaphoreA(NULL, 0, CAPTURE_SLOT_COUNT + 1, NULL);
+    capture->thread       = CreateThread(NULL, 0, captureWriterProc, capture, 0, NULL);
+    ASSERT(capture->framesQueued != NULL && capture->thread != NULL);
+    return capture;
+}
+
+bool captureSubmit(CaptureContext* capture, Bitmap* frame) {
+    ASSERT(frame->width == capture->width && frame->height == capture->height);
+    capture->submitted++;
+    LONG write = capture->writeIndex;
+    if ((u32)(write - capture->readIndex) == CAPTURE_SLOT_COUNT) {
+        capture->dropped++;
+        return false;
+    }
+
+    memcpy(captureSlot(capture, write), frame->data, sizeof(u32) * frame->width*frame->height);
+    InterlockedExchange(&capture->writeIndex, write + 1);
+    ReleaseSemaphore(capture->framesQueued, 1, NULL);
+    return true;
+}
+
+CaptureStats captureGetStats(CaptureContext* capture) {
+    return {
+        .submitted = capture->submitted,
+        .dropped   = capture->dropped,
+    };
+}
+
+void captureStop(CaptureContext* capture, bool wait) {
+    HANDLE thread = capture->thread;
+    InterlockedExchange(&capture->stopping, 1);
+    ReleaseSemaphore(capture->framesQueued, 1, NULL);
+    captureRelease(capture);
+    // capture may already be gone here
+    if (wait) {
+        WaitForSingleObject(thread, INFINITE);
+    }
+    CloseHandle(thread);
+}
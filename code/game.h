@@ -0,0 +1,336 @@
+#ifndef BREAKOUT_GAME_H_
+#define BREAKOUT_GAME_H_
+
+#include "base.h"
+
+// Gameplay only, no platform or rendering code, so it can also be stepped
+// by headless tools. All state lives in GameState.
+
+#define WIDTH  1080
+#define HEIGHT 720
+
+// gameplay is stepped at a fixed rate so it is reproducible tick by tick
+static constexpr float GAME_TICK_SECONDS = 1.0f / 240.0f;
+
+struct PlayerInput {
+    bool left;
+    bool right;
+    bool a;
+    bool d;
+};
+
+struct Box {
+    Vec2 center;
+    Vec2 halfExtents;
+};
+
+struct Circle {
+    Vec2  center;
+    float radius;
+};
+
+struct Ball {
+    Circle circle;
+    Vec2   velocity;
+    bool   alive;
+    bool   ignoreTiles;
+};
+
+#define MAX_TILES 128
+#define TILE_MASK_WORDS ((MAX_TILES + 63) / 64)
+
+// Tiles keep their index for the whole round, destroying one only clears
+// its bit in alive so the index can be used as a stable tile id.
+struct Tiles {
+    float centerX[MAX_TILES];
+    float centerY[MAX_TILES];
+    float halfExtentX[MAX_TILES];
+    float halfExtentY[MAX_TILES];
+    u64   alive[TILE_MASK_WORDS];
+    int   count;
+};
+
+#define BALL_SPEED 400.0f
+
+// Player 0 defends the bottom edge. In versus mode player 1 defends the top
+// edge and the tiles sit in between.
+#define MAX_PLAYERS 2
+
+struct GameState {
+    Tiles tiles;
+    Box   players[MAX_PLAYERS];
+    u32   playerCount;
+    Ball  ball;
+    bool  startedRound;
+    u32   servingPlayer;
+    u32   lastHitPlayer;
+    int   scores[MAX_PLAYERS];
+    u32   ballsLost;
+    u64   tick;
+};
+
+enum GameEventType {
+    GAME_EVENT_TILE_DESTROYED,
+    GAME_EVENT_PADDLE_HIT,
+    GAME_EVENT_BALL_LOST,
+};
+
+struct GameEvent {
+    GameEventType type;
+    Vec2          position;
+    Vec2          halfExtents;
+};
+
+// What happened during a gameUpdate, for effects and sounds. Events past
+// MAX_GAME_EVENTS are dropped.
+#define MAX_GAME_EVENTS 16
+struct GameEvents {
+    GameEvent events[MAX_GAME_EVENTS];
+    u32       count;
+};
+
+static void pushGameEvent(GameEvents* events, GameEventType type, Vec2 position, Vec2 halfExtents) {
+    if (events && events->count < MAX_GAME_EVENTS) {
+        events->events[events->count++] = {type, position, halfExtents};
+    }
+}
+
+static void resetPlayers(GameState* game) {
+    game->players[0] = {
+        .center      = vec2(540, 600),
+        .halfExtents = vec2(70, 5),
+    };
+    game->players[1] = {
+        .center      = vec2(540, HEIGHT - 600),
+        .halfExtents = vec2(70, 5),
+    };
+}
+
+static void resetBall(GameState* game) {
+    game->ball = {
+        .circle = {
+            .center = vec2(540, game->playerCount > 1 ? HEIGHT * 0.5f : 150),
+            .radius = 8,
+        },
+        .velocity = vec2(0,0),
+        .ignoreTiles = true,
+    };
+}
+
+static Box getTileBox(Tiles* tiles, int id) {
+    return {
+        .center      = vec2(tiles->centerX[id], tiles->centerY[id]),
+        .halfExtents = vec2(tiles->halfExtentX[id], tiles->halfExtentY[id]),
+    };
+}
+
+static bool isTileAlive(Tiles* tiles, int id) {
+    return (tiles->alive[id >> 6] >> (id & 63)) & 1;
+}
+
+static void killTile(Tiles* tiles, int id) {
+    tiles->alive[id >> 6] &= ~(1ull << (id & 63));
+}
+
+static int countAliveTiles(Tiles* tiles) {
+    int count = 0;
+    for (int w = 0; w < TILE_MASK_WORDS; w++) {
+        count += popCount(tiles->alive[w]);
+    }
+    return count;
+}
+
+// top is the y coordinate of the top edge of the first row
+static void makeTileGrid(Tiles* tiles, float top) {
+    int gridWidth  = 10;
+    int gridHeight = 4;
+    *tiles = {};
+    tiles->count = gridWidth * gridHeight;
+    ASSERT(tiles->count <= MAX_TILES);
+
+    float horizontalPadding = 20;
+    float horizontalSpacing = 5;
+    float verticalSpacing   = 5;
+    Vec2 halfExtents = vec2(
+        (WIDTH - horizontalPadding*2 - horizontalSpacing * (gridWidth-1)) / gridWidth * 0.5f,
+        10.0f
+    );
+
+    for (int y = 0; y < gridHeight; y++) {
+        Vec2 offset = vec2(
+            horizontalPadding + halfExtents.x,
+            top + halfExtents.y + y * (halfExtents.y * 2 + verticalSpacing)
+        );
+        for (int x = 0; x < gridWidth; x++) {
+            int id = y * gridWidth + x;
+            tiles->centerX[id]     = offset.x;
+            tiles->centerY[id]     = offset.y;
+            tiles->halfExtentX[id] = halfExtents.x;
+            tiles->halfExtentY[id] = halfExtents.y;
+            tiles->alive[id >> 6] |= 1ull << (id & 63);
+            offset.x += halfExtents.x * 2 + horizontalSpacing;
+        }
+    }
+}
+
+static bool checkCollisionAndResolve(Box* box, Circle* circle, Vec2* hitNormal) {
+    *hitNormal = vec2(0,0);
+    Vec2 diff = circle->center - box->center;
+    Vec2 d = diff;
+    d = abs(d) - vec2(circle->radius);
+    // strict so that merely touching, which has no correction to normalize, is not a hit
+    bool colliding  = (d.x < box->halfExtents.x) &&
+                      (d.y < box->halfExtents.y);
+
+    if (colliding) {
+        Vec2 absDiff = box->halfExtents - abs(diff);
+        Vec2 correction = vec2(0,0);
+        if (absDiff.x <= absDiff.y) {
+            float sign = diff.x >= 0 ? 1 : -1;
+            correction.x = sign * (box->halfExtents.x + circle->radius) - diff.x;
+        } else {
+            float sign = diff.y >= 0 ? 1 : -1;
+            correction.y = sign * (box->halfExtents.y + circle->radius) - diff.y;
+        }
+        circle->center += correction;
+        *hitNormal = normalize(correction);
+    }
+
+    return colliding;
+}
+
+// Returns the id of the first alive tile the circle was resolved against, or -1.
+static int collideWithTiles(Tiles* tiles, Circle* circle, Vec2* hitNormal) {
+    for (int w = 0; w < TILE_MASK_WORDS; w++) {
+        u64 mask = tiles->alive[w];
+        while (mask) {
+            int id = w * 64 + countTrailingZeros(mask);
+            mask &= mask - 1;
+
+            Box box = getTileBox(tiles, id);
+            if (checkCollisionAndResolve(&box, circle, hitNormal)) {
+                return id;
+            }
+        }
+    }
+    return -1;
+}
+
+static bool hasAnyInput(PlayerInput* input) {
+    return input->left || input->right || input->a || input->d;
+}
+
+// playerCount 2 starts a versus round
+static void gameInit(GameState* game, u32 playerCount = 1) {
+    ASSERT(playerCount >= 1 && playerCount <= MAX_PLAYERS);
+    *game = {};
+    game->playerCount = playerCount;
+    resetPlayers(game);
+    resetBall(game);
+    makeTileGrid(&game->tiles, playerCount > 1 ? HEIGHT * 0.5f - 47.5f : 40);
+}
+
+static void ballLost(GameState* game, u32 player, GameEvents* events) {
+    Ball* ball = &game->ball;
+    pushGameEvent(events, GAME_EVENT_BALL_LOST, ball->circle.center, vec2(ball->circle.radius));
+    game->startedRound  = false;
+    game->servingPlayer = player;
+    game->ballsLost++;
+    if (game->playerCount > 1) {
+        game->scores[1 - player] += 50;
+    }
+    resetBall(game);
+}
+
+// inputs holds one entry per player, events may be NULL
+static void gameUpdate(GameState* game, PlayerInput* inputs, float deltaSeconds, GameEvents* events) {
+    Ball* ball = &game->ball;
+    game->tick++;
+
+    if (!game->startedRound) {
+        if (hasAnyInput(&inputs[game->servingPlayer])) {
+            game->startedRound  = true;
+            game->lastHitPlayer = game->servingPlayer;
+
+            // serve towards the player who lost the last ball
+            ball->velocity = vec2(0, game->servingPlayer == 0 ? BALL_SPEED : -BALL_SPEED);
+        } else {
+            return;
+        }
+    }
+
+    for (u32 i = 0; i < game->playerCount; i++) {
+        PlayerInput* input  = &inputs[i];
+        Box*         player = &game->players[i];
+
+        float playerSpeedX = 0;
+        if (input->left || input->a) {
+            playerSpeedX -= 350;
+        }
+        if (input->right || input->d) {
+            playerSpeedX += 350;
+        }
+
+        player->center.x += playerSpeedX * deltaSeconds;
+        if (player->center.x < 0) {
+            player->center.x = 0;
+        } else if (player->center.x > WIDTH) {
+            player->center.x = WIDTH;
+        }
+    }
+
+    ball->circle.center += deltaSeconds * ball->velocity;
+
+    Vec2 hitNormal;
+    for (u32 i = 0; i < game->playerCount; i++) {
+        Box* player = &game->players[i];
+        if (!checkCollisionAndResolve(player, &ball->circle, &hitNormal)) {
+            continue;
+        }
+
+        // the side of the paddle that faces the tiles
+        float facing = i == 0 ? -1.0f : 1.0f;
+        if (hitNormal.y * facing > 0) {
+            Vec2 dir = (ball->circle.center - player->center);
+            dir.x *= 0.5f;
+            dir = normalize(dir);
+            ball->velocity = BALL_SPEED * dir;
+            game->lastHitPlayer = i;
+            pushGameEvent(events, GAME_EVENT_PADDLE_HIT, ball->circle.center - vec2(0, facing * ball->circle.radius),
+                          vec2(ball->circle.radius, 1));
+        } else {
+            ball->velocity = reflect(ball->velocity, hitNormal);
+        }
+        ball->ignoreTiles = false;
+    }
+
+    if (!ball->ignoreTiles) {
+        int hitTile = collideWithTiles(&game->tiles, &ball->circle, &hitNormal);
+        if (hitTile >= 0) {
+            killTile(&game->tiles, hitTile);
+            game->scores[game->lastHitPlayer] += 10;
+            Box box = getTileBox(&game->tiles, hitTile);
+            pushGameEvent(events, GAME_EVENT_TILE_DESTROYED, box.center, box.halfExtents);
+            ball->velocity = reflect(ball->velocity, hitNormal);
+        }
+    }
+
+    if (ball->circle.center.y - ball->circle.radius <= 0) {
+        if (game->playerCount > 1) {
+            ballLost(game, 1, events);
+            return;
+        }
+        ball->velocity.y = fabs(ball->velocity.y);
+    }
+    if (ball->circle.center.x - ball->circle.radius <= 0) {
+        ball->velocity.x = fabs(ball->velocity.x);
+    } else if (ball->circle.center.x + ball->circle.radius >= WIDTH) {
+        ball->velocity.x = -fabs(ball->velocity.x);
+    }
+
+    if (ball->circle.center.y + ball->circle.radius >= HEIGHT) {
+        ballLost(game, 0, events);
+    }
+}
+
+#endif // BREAKOUT_GAME_H_
@@ -0,0 +1,170 @@
+#ifndef BREAKOUT_PARTICLES_H_
+#define BREAKOUT_PARTICLES_H_
+
+#include "render.h"
+
+#include <emmintrin.h>
+
+// Fixed capacity pool stored as SoA so integration runs four particles per
+// instruction. Alive particles are always packed in [0, count), spawning
+// appends and dying swaps the last particle into the freed slot.
+struct ParticleSystem {
+    float* posX;
+    float* posY;
+    float* velX;
+    float* velY;
+    float* life;     // seconds left
+    u32*   color;
+    u8*    colorIndex; // palette index for indexed targets
+    u32    count;
+    u32    capacity; // multiple of 4
+    float  gravity;
+    u32    randomState;
+};
+
+static ParticleSystem* makeParticleSystem(Arena* arena, u32 capacity) {
+    capacity = (capacity + 3) & ~3u;
+    ParticleSystem* system = push(arena, ParticleSystem);
+    if (!system) {
+        return NULL;
+    }
+    *system = {};
+    system->posX  = (float*)allocate(arena, sizeof(float) * capacity, 16);
+    system->posY  = (float*)allocate(arena, sizeof(float) * capacity, 16);
+    system->velX  = (float*)allocate(arena, sizeof(float) * capacity, 16);
+    system->velY  = (float*)allocate(arena, sizeof(float) * capacity, 16);
+    system->life  = (float*)allocate(arena, sizeof(float) * capacity, 16);
+    system->color = (u32*)allocate(arena, sizeof(u32) * capacity, 16);
+    system->colorIndex = (u8*)allocate(arena, sizeof(u8) * capacity, 16);
+    if (!system->posX || !system->posY || !system->velX || !system->velY ||
+        !system->life || !system->color || !system->colorIndex) {
+        return NULL;
+    }
+    // the SIMD loops run up to the next multiple of 4, keep those lanes harmless
+    memset(system->life, 0, sizeof(float) * capacity);
+    system->capacity    = capacity;
+    system->gravity     = 600.0f;
+    system->randomState = 0x9e3779b9;
+    return system;
+}
+
+static void spawnParticle(ParticleSystem* system, Vec2 position, Vec2 velocity, float life,
+                          u32 color, u8 colorIndex) {
+    if (system->count == system->capacity) {
+        return;
+    }
+    u32 i = system->count++;
+    system->posX[i]       = position.x;
+    system->posY[i]       = position.y;
+    system->velX[i]       = velocity.x;
+    system->velY[i]       = velocity.y;
+    system->life[i]       = life;
+    system->color[i]      = color;
+    system->colorIndex[i] = colorIndex;
+}
+
+// Spawns count particles spread over a box, flying away from its center
+static void emitParticleBurst(ParticleSystem* system, Vec2 center, Vec2 halfExtents,
+                              u32 color, u32 count, float speed, u8 colorIndex = 0) {
+    u32* random = &system->randomState;
+    for (u32 i = 0; i < count; i++) {
+        Vec2 offset = vec2(randomBilateral(random), randomBilateral(random));
+        Vec2 velocity = vec2(offset.x + 0.3f*randomBilateral(random),
+                             offset.y + 0.3f*randomBilateral(random)) * (speed * (0.25f + randomUnilateral(random)));
+        float life = 0.4f + 0.6f*randomUnilateral(random);
+        spawnParticle(system, center + offset*halfExtents, velocity, life, color, colorIndex);
+    }
+}
+
+static void killParticle(ParticleSystem* system, u32 i) {
+    u32 last = --system->count;
+    system->posX[i]       = system->posX[last];
+    system->posY[i]       = system->posY[last];
+    system->velX[i]       = system->velX[last];
+    system->velY[i]       = system->velY[last];
+    system->life[i]       = system->life[last];
+    system->color[i]      = system->color[last];
+    system->colorIndex[i] = system->colorIndex[last];
+    system->life[last] = 0;
+}
+
+static void updateParticles(ParticleSystem* system, float deltaSeconds) {
+    __m128 dt      = _mm_set1_ps(deltaSeconds);
+    __m128 gravity = _mm_set1_ps(system->gravity * deltaSeconds);
+    for (u32 i = 0; i < system->count; i += 4) {
+        __m128 velX = _mm_load_ps(system->velX + i);
+        __m128 velY = _mm_add_ps(_mm_load_ps(system->velY + i), gravity);
+        _mm_store_ps(system->posX + i, _mm_add_ps(_mm_load_ps(system->posX + i), _mm_mul_ps(velX, dt)));
+        _mm_store_ps(system->posY + i, _mm_add_ps(_mm_load_ps(system->posY + i), _mm_mul_ps(velY, dt)));
+        _mm_store_ps(system->velY + i, velY);
+        _mm_store_ps(system->life + i, _mm_sub_ps(_mm_load_ps(system->life + i), dt));
+    }
+
+    // only groups of four that contain a dead particle leave the SIMD path
+    __m128 zero = _mm_setzero_ps();
+    for (u32 i = 0; i < system->count; i += 4) {
+        if (_mm_movemask_ps(_mm_cmple_ps(_mm_load_ps(system->life + i), zero)) == 0) {
+            continue;
+        }
+        u32 end = min((i32)(i + 4), (i32)system->count);
+        for (u32 j = i; j < end; ) {
+            if (system->life[j] <= 0) {
+                killParticle(system, j);
+                end = min((i32)end, (i32)system->count);
+            } else {
+                j++;
+            }
+        }
+    }
+}
+
+// Every particle is a 2x2 quad, positions are converted four at a time
+static void drawParticles(ParticleSystem* system, Bitmap* bitmap) {
+    u32 width  = bitmap->width;
+    u32 height = bitmap->height;
+    alignas(16) i32 xs[4];
+    alignas(16) i32 ys[4];
+    for (u32 i = 0; i < system->count; i += 4) {
+        _mm_store_si128((__m128i*)xs, _mm_cvttps_epi32(_mm_load_ps(system->posX + i)));
+        _mm_store_si128((__m128i*)ys, _mm_cvttps_epi32(_mm_load_ps(system->posY + i)));
+        u32 end = min(4, (i32)(system->count - i));
+        for (u32 j = 0; j < end; j++) {
+            // unsigned compares reject negative coordinates as well
+            if ((u32)xs[j] >= width - 1 || (u32)ys[j] >= height - 1) {
+                continue;
+            }
+            u32  color = system->color[i + j];
+            u32* p     = &bitmap->data[ys[j] * width + xs[j]];
+            p[0]         = color;
+            p[1]         = color;
+            p[width]     = color;
+            p[width + 1] = color;
+        }
+    }
+}
+
+static void drawParticlesIndexed(ParticleSystem* system, IndexedBitmap* bitmap) {
+    u32 width  = bitmap->width;
+    u32 height = bitmap->height;
+    alignas(16) i32 xs[4];
+    alignas(16) i32 ys[4];
+    for (u32 i = 0; i < system->count; i += 4) {
+        _mm_store_si128((__m128i*)xs, _mm_cvttps_epi32(_mm_load_ps(system->posX + i)));
+        _mm_store_si128((__m128i*)ys, _mm_cvttps_epi32(_mm_load_ps(system->posY + i)));
+        u32 end = min(4, (i32)(system->count - i));
+        for (u32 j = 0; j < end; j++) {
+            // unsigned compares reject negative coordinates as well
+            if ((u32)xs[j] >= width - 1 || (u32)ys[j] >= height - 1) {
+                continue;
+            }
+            u8  color = system->colorIndex[i + j];
+            u8* p     = &bitmap->data[ys[j] * width + xs[j]];
+            p[0]         = color;
+            p[1]         = color;
+            p[width]     = color;
+            p[width + 1] = color;
+        }
+    }
+}
+
+#endif // BREAKOUT_PARTICLES_H_
@@ -0,0 +1,101 @@
+#ifndef BREAKOUT_PERF_HUD_H_
+#define BREAKOUT_PERF_HUD_H_
+
+#include "text.h"
+
+#define PERF_HISTORY_COUNT 128
+#define PERF_MAX_ARENAS    4
+
+struct PerfArena {
+    const char* name;
+    Arena*      arena;
+};
+
+// All times in milliseconds. The breakdown is smoothed so the numbers are
+// readable, the frame time graph shows the raw history.
+struct PerfStats {
+    float frameHistory[PERF_HISTORY_COUNT];
+    u32   historyIndex;
+
+    float frameMs;
+    float simMs;
+    float renderMs;
+    float mixMs;
+    float presentMs;
+    // from the key event that changed the input to the end of the present showing its effect
+    float latencyMs;
+
+    PerfArena arenas[PERF_MAX_ARENAS];
+    u32       arenaCount;
+
+    // free form line shown under the timings when not empty
+    char      status[96];
+};
+
+static void perfTrackArena(PerfStats* stats, const char* name, Arena* arena) {
+    ASSERT(stats->arenaCount < PERF_MAX_ARENAS);
+    stats->arenas[stats->arenaCount++] = {name, arena};
+}
+
+static void perfRecordFrame(PerfStats* stats, float frameMs, float simMs, float renderMs,
+                            float mixMs, float presentMs) {
+    stats->frameHistory[stats->historyIndex] = frameMs;
+    stats->historyIndex = (stats->historyIndex + 1) % PERF_HISTORY_COUNT;
+
+    float t = 0.05f;
+    stats->frameMs   += t * (frameMs   - stats->frameMs);
+    stats->simMs     += t * (simMs     - stats->simMs);
+    stats->renderMs  += t * (renderMs  - stats->renderMs);
+    stats->mixMs     += t * (mixMs     - stats->mixMs);
+    stats->presentMs += t * (presentMs - stats->presentMs);
+}
+
+static void perfRecordLatency(PerfStats* stats, float latencyMs) {
+    stats->latencyMs += 0.05f * (latencyMs - stats->latencyMs);
+}
+
+static void drawPerfHud(PerfStats* stats, TextBatch* batch, Font* font, Bitmap* bitmap) {
+    float graphHeight = 60;
+    float pixelsPerMs = graphHeight / 33.3f;
+    u32   lineCount   = 4 + stats->arenaCount + (stats->status[0] ? 1 : 0);
+    Vec2  panelMin    = vec2(8, (float)bitmap->height - 8 - graphHeight - 12 - lineCount * font->lineHeight);
+    Vec2  panelSize   = vec2(2*PERF_HISTORY_COUNT + 16, (float)bitmap->height - 8 - panelMin.y);
+    drawSquareBlended(0xb0000000, panelMin + panelSize*0.5f, panelSize*0.5f, bitmap);
+
+    Vec2 cursor = panelMin + vec2(8, 6);
+    float fps = stats->frameMs > 0 ? 1000.0f / stats->frameMs : 0;
+    pushTextF(batch, font, cursor, 0xffffffff, "FRAME %6.2f MS %5.0f FPS", stats->frameMs, fps);
+    cursor.y += font->lineHeight;
+    pushTextF(batch, font, cursor, 0xffc0c0c0, "SIM %5.2f  RENDER %5.2f", stats->simMs, stats->renderMs);
+    cursor.y += font->lineHeight;
+    pushTextF(batch, font, cursor, 0xffc0c0c0, "MIX %5.2f  PRESENT %5.2f", stats->mixMs, stats->presentMs);
+    cursor.y += font->lineHeight;
+    pushTextF(batch, font, cursor, 0xffc0c0c0, "INPUT TO PRESENT %5.2f", stats->latencyMs);
+    cursor.y += font->lineHeight;
+    if (stats->status[0]) {
+        pushText(batch, font, cursor, 0xffc0c0c0, stats->status);
+        cursor.y += font->lineHeight;
+    }
+    for (u32 i = 0; i < stats->arenaCount; i++) {
+        PerfArena* a = &stats->arenas[i];
+        pushTextF(batch, font, cursor, 0xffc0c0c0, "%-9s %7.1f/%.0f KB", a->name,
+                  a->arena->offset / 1024.0f, a->arena->capacity / 1024.0f);
+        cursor.y += font->lineHeight;
+    }
+    flushText(batch, font, bitmap);
+
+    // oldest sample on the left, bars are green under 60 Hz, yellow under 30 Hz
+    float baseline = panelMin.y + panelSize.y - 6;
+    for (u32 i = 0; i < PERF_HISTORY_COUNT; i++) {
+        float ms = stats->frameHistory[(stats->historyIndex + i) % PERF_HISTORY_COUNT];
+        float height = min(ms * pixelsPerMs, graphHeight);
+        u32 color = ms <= 16.7f ? 0xff00c000 : ms <= 33.3f ? 0xffc0c000 : 0xffc00000;
+        float x = panelMin.x + 8 + 2*i;
+        drawSquare(color, vec2(x, baseline - height*0.5f), vec2(0.5f, height*0.5f), bitmap);
+    }
+    float targetY = baseline - 16.7f * pixelsPerMs;
+    drawSquareBlended(0x80808080, vec2(panelMin.x + panelSize.x*0.5f, targetY),
+                      vec2(panelSize.x*0.5f - 8, 0), bitmap);
+}
+
+#endif // BREAKOUT_PERF_HUD_H_
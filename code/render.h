@@ -0,0 +1,1137 @@
+#ifndef BREAKOUT_RENDER_H_
+#define BREAKOUT_RENDER_H_
+
+#include "base.h"
+
+#include <emmintrin.h>
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+// Pixels are 0xAARRGGBB with premultiplied alpha
+struct Bitmap {
+    u32* data;
+    u32  width;
+    u32  height;
+};
+
+struct BitmapRegion {
+    u32 x;
+    u32 y;
+    u32 width;
+    u32 height;
+};
+
+enum BlitFilter {
+    BLIT_NEAREST,
+    BLIT_BILINEAR,
+};
+
+static void fillSpan(u32* p, int count, u32 color) {
+    __m128i c = _mm_set1_epi32((int)color);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_si128((__m128i*)(p + i), c);
+    }
+    for (; i < count; i++) {
+        p[i] = color;
+    }
+}
+
+static void drawSquare(u32 color, Vec2 center, Vec2 halfSize, Bitmap* bitmap) {
+    int minX = (int)(center.x - halfSize.x);
+    int minY = (int)(center.y - halfSize.y);
+    int maxX = (int)(center.x + halfSize.x) + 1;
+    int maxY = (int)(center.y + halfSize.y) + 1;
+
+    if (minX >= (int)bitmap->width || minY >= (int)bitmap->height ||
+        maxX <= 0 || maxY <= 0) {
+        return;
+    }
+
+    minX = minX >= 0 ? minX : 0;
+    minY = minY >= 0 ? minY : 0;
+    maxX = maxX <= (int)bitmap->width  ? maxX : (int)bitmap->width;
+    maxY = maxY <= (int)bitmap->height ? maxY : (int)bitmap->height;
+
+    for (int y = minY; y < maxY; y++) {
+        fillSpan(&bitmap->data[y * bitmap->width + minX], maxX - minX, color);
+    }
+}
+
+static bool circleContains(Vec2 center, float radiusSquared, int x, int y) {
+    Vec2 d = vec2(x,y) - center;
+    return dot(d,d) <= radiusSquared;
+}
+
+static void drawCircle(u32 color, Vec2 center, float radius, Bitmap* bitmap) {
+    int minX = (int)(center.x - radius);
+    int minY = (int)(center.y - radius);
+    int maxX = (int)(center.x + radius) + 1;
+    int maxY = (int)(center.y + radius) + 1;
+
+    if (minX >= (int)bitmap->width || minY >= (int)bitmap->height ||
+        maxX < 0 || maxY < 0) {
+        return;
+    }
+
+    minX = minX >= 0 ? minX : 0;
+    minY = minY >= 0 ? minY : 0;
+    maxX = maxX <= (int)bitmap->width  ? maxX : (int)bitmap->width;
+    maxY = maxY <= (int)bitmap->height ? maxY : (int)bitmap->height;
+
+    float radiusSquared = radius*radius;
+    for (int y = minY; y < maxY; y++) {
+        float dy = (float)y - center.y;
+        if (dy*dy > radiusSquared) {
+            continue;
+        }
+        // The truncated span from the square root can be a pixel off the per
+        // pixel test, its ends are moved until they agree.
+        float halfWidth = sqrtf(radiusSquared - dy*dy);
+        int start = max((int)(center.x - halfWidth), minX);
+        int end   = max(min((int)(center.x + halfWidth) + 1, maxX), start);
+        while (start > minX && circleContains(center, radiusSquared, start - 1, y)) {
+            start--;
+        }
+        while (start < end && !circleContains(center, radiusSquared, start, y)) {
+            start++;
+        }
+        while (end < maxX && circleContains(center, radiusSquared, end, y)) {
+            end++;
+        }
+        while (end > start && !circleContains(center, radiusSquared, end - 1, y)) {
+            end--;
+        }
+        fillSpan(&bitmap->data[y * bitmap->width + start], end - start, color);
+    }
+}
+
+// dst*(255 - srcAlpha)/255 + src, with the division rounded as (x + 128 + ((x + 128) >> 8)) >> 8
+// so the scalar and SIMD paths produce the same bits.
+static u32 blendPremultiplied(u32 src, u32 dst) {
+    u32 invAlpha = 255 - (src >> 24);
+    u32 rb = (dst & 0x00ff00ff) * invAlpha + 0x00800080;
+    u32 ag = ((dst >> 8) & 0x00ff00ff) * invAlpha + 0x00800080;
+    rb = ((rb + ((rb >> 8) & 0x00ff00ff)) >> 8) & 0x00ff00ff;
+    ag = (ag + ((ag >> 8) & 0x00ff00ff)) & 0xff00ff00;
+    return src + (rb | ag);
+}
+
+static __m128i blendPremultiplied4(__m128i src, __m128i dst) {
+    __m128i zero  = _mm_setzero_si128();
+    __m128i bias  = _mm_set1_epi16(128);
+    __m128i alpha = _mm_srli_epi32(src, 24);
+    alpha = _mm_or_si128(alpha, _mm_slli_epi32(alpha, 16));
+    __m128i invAlpha   = _mm_sub_epi16(_mm_set1_epi16(255), alpha);
+    __m128i invAlphaLo = _mm_unpacklo_epi32(invAlpha, invAlpha);
+    __m128i invAlphaHi = _mm_unpackhi_epi32(invAlpha, invAlpha);
+
+    __m128i lo = _mm_unpacklo_epi8(dst, zero);
+    __m128i hi = _mm_unpackhi_epi8(dst, zero);
+    lo = _mm_add_epi16(_mm_mullo_epi16(lo, invAlphaLo), bias);
+    hi = _mm_add_epi16(_mm_mullo_epi16(hi, invAlphaHi), bias);
+    lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+    hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+
+    return _mm_adds_epu8(src, _mm_packus_epi16(lo, hi));
+}
+
+static void blendSpan(u32* dst, u32* src, int count) {
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i s = _mm_loadu_si128((__m128i*)(src + i));
+        __m128i d = _mm_loadu_si128((__m128i*)(dst + i));
+        _mm_storeu_si128((__m128i*)(dst + i), blendPremultiplied4(s, d));
+    }
+    for (; i < count; i++) {
+        dst[i] = blendPremultiplied(src[i], dst[i]);
+    }
+}
+
+static void blendColorSpan(u32* p, int count, u32 color) {
+    __m128i src = _mm_set1_epi32((int)color);
+    int x = 0;
+    for (; x + 4 <= count; x += 4) {
+        __m128i d = _mm_loadu_si128((__m128i*)(p + x));
+        _mm_storeu_si128((__m128i*)(p + x), blendPremultiplied4(src, d));
+    }
+    for (; x < count; x++) {
+        p[x] = blendPremultiplied(color, p[x]);
+    }
+}
+
+// Like drawSquare but blends the premultiplied color over the bitmap
+static void drawSquareBlended(u32 color, Vec2 center, Vec2 halfSize, Bitmap* bitmap) {
+    int minX = max((int)(center.x - halfSize.x), 0);
+    int minY = max((int)(center.y - halfSize.y), 0);
+    int maxX = min((int)(center.x + halfSize.x) + 1, (int)bitmap->width);
+    int maxY = min((int)(center.y + halfSize.y) + 1, (int)bitmap->height);
+
+    for (int y = minY; y < maxY; y++) {
+        blendColorSpan(&bitmap->data[y * bitmap->width + minX], maxX - minX, color);
+    }
+}
+
+// Anti-aliased shapes. Every pixel gets the part of its area covered by the
+// shape as a 0..AA_ONE coverage. Fully covered spans go through fillSpan like
+// the aliased shapes, only the partially covered edge pixels are blended.
+
+#define AA_SUBPIXEL_BITS 8
+#define AA_ONE           (1 << AA_SUBPIXEL_BITS)
+
+// coverage is 0..AA_ONE
+static u32 scaleColor(u32 color, u32 coverage) {
+    u32 rb = (((color & 0x00ff00ff) * coverage) >> AA_SUBPIXEL_BITS) & 0x00ff00ff;
+    u32 ag = (((color >> 8) & 0x00ff00ff) * coverage) & 0xff00ff00;
+    return rb | ag;
+}
+
+static void blendCoverage(u32* p, u32 color, u32 coverage) {
+    *p = blendPremultiplied(scaleColor(color, coverage), *p);
+}
+
+// One row of a rectangle from x0 to x1, both in fixed point. Rows the
+// rectangle only partly covers scale every pixel by rowCoverage.
+static void drawCoverageRow(u32* row, u32 color, i32 x0, i32 x1, u32 rowCoverage) {
+    i32 first = x0 >> AA_SUBPIXEL_BITS;
+    i32 last  = (x1 - 1) >> AA_SUBPIXEL_BITS;
+    if (first == last) {
+        blendCoverage(row + first, color, ((u32)(x1 - x0) * rowCoverage) >> AA_SUBPIXEL_BITS);
+        return;
+    }
+
+    u32 firstCoverage = AA_ONE - (x0 & (AA_ONE - 1));
+    u32 lastCoverage  = (u32)(x1 - (last << AA_SUBPIXEL_BITS));
+    i32 spanStart     = first + (firstCoverage < AA_ONE ? 1 : 0);
+    i32 spanEnd       = last  + (lastCoverage == AA_ONE ? 1 : 0);
+    if (firstCoverage < AA_ONE) {
+        blendCoverage(row + first, color, (firstCoverage * rowCoverage) >> AA_SUBPIXEL_BITS);
+    }
+    if (rowCoverage == AA_ONE) {
+        fillSpan(row + spanStart, spanEnd - spanStart, color);
+    } else {
+        blendColorSpan(row + spanStart, spanEnd - spanStart, scaleColor(color, rowCoverage));
+    }
+    if (lastCoverage < AA_ONE) {
+        blendCoverage(row + last, color, (lastCoverage * rowCoverage) >> AA_SUBPIXEL_BITS);
+    }
+}
+
+static void drawSquareAA(u32 color, Vec2 center, Vec2 halfSize, Bitmap* bitmap) {
+    // edges in fixed point, clipping to the bitmap makes the clipped edges whole pixels
+    i32 x0 = max((i32)((center.x - halfSize.x) * AA_ONE), 0);
+    i32 y0 = max((i32)((center.y - halfSize.y) * AA_ONE), 0);
+    i32 x1 = min((i32)((center.x + halfSize.x) * AA_ONE), (i32)bitmap->width  << AA_SUBPIXEL_BITS);
+    i32 y1 = min((i32)((center.y + halfSize.y) * AA_ONE), (i32)bitmap->height << AA_SUBPIXEL_BITS);
+    if (x0 >= x1 || y0 >= y1) {
+        return;
+    }
+
+    i32 firstRow = y0 >> AA_SUBPIXEL_BITS;
+    i32 lastRow  = (y1 - 1) >> AA_SUBPIXEL_BITS;
+    for (i32 y = firstRow; y <= lastRow; y++) {
+        i32 top    = max(y0, y << AA_SUBPIXEL_BITS);
+        i32 bottom = min(y1, (y + 1) << AA_SUBPIXEL_BITS);
+        drawCoverageRow(&bitmap->data[y * bitmap->width], color, x0, x1, (u32)(bottom - top));
+    }
+}
+
+// Circle coverage is looked up rather than computed per pixel. The table
+// holds the exact area of the circle over every pixel around the center
+// pixel, for centers at every 1/CIRCLE_PHASES pixel in both axes, and is
+// built once per radius. A center between those phases interpolates the
+// four around it in fixed point, which keeps pixels within 4/255 of their
+// exact area. Each cell between four phases keeps the solid span and edge
+// pixels of its rows.
+#define CIRCLE_AA_MAX_RADIUS 16
+#define CIRCLE_PHASE_BITS    4
+#define CIRCLE_PHASES        (1 << CIRCLE_PHASE_BITS)
+#define CIRCLE_MAX_ROWS      (2*CIRCLE_AA_MAX_RADIUS + 1)
+// four empty columns on either side let every edge be read four pixels at a time
+#define CIRCLE_MAX_PITCH     (CIRCLE_MAX_ROWS + 8)
+
+// columns relative to the center pixel, the span is fully covered for every
+// center in the cell
+struct CircleSpan {
+    i8 edgeStart;
+    i8 spanStart;
+    i8 spanEnd;
+    i8 edgeEnd;
+};
+
+struct CircleCoverage {
+    i32        radius; // the table is for this radius, in 1/AA_ONE pixels
+    i32        size;   // rows and columns on either side of the center pixel
+    i32        pitch;
+    // [phase y][phase x][row][column] as 0..255, phases from 0 to CIRCLE_PHASES
+    u8         coverage[(CIRCLE_PHASES + 1)*(CIRCLE_PHASES + 1)*CIRCLE_MAX_ROWS*CIRCLE_MAX_PITCH];
+    CircleSpan spans[CIRCLE_PHASES*CIRCLE_PHASES*CIRCLE_MAX_ROWS];
+};
+
+static CircleCoverage g_circleCoverage;
+
+// Area of the circle of radius r around the origin within [0, x] x [0, y],
+// negative when x or y is. Past the arc it is the rectangle up to where the
+// arc crosses y plus the area under the arc from there.
+static double circleCornerArea(double x, double y, double r) {
+    double sign = (x < 0) == (y < 0) ? 1 : -1;
+    x = min(fabs(x), r);
+    y = min(fabs(y), r);
+    if (x*x + y*y <= r*r) {
+        return sign*x*y;
+    }
+    double arcX = sqrt(r*r - y*y);
+    double underArc = 0.5*(x*sqrt(r*r - x*x) + r*r*asin(x / r)) - 0.5*(arcX*y + r*r*asin(arcX / r));
+    return sign*(arcX*y + underArc);
+}
+
+static void buildCircleCoverage(i32 radius) {
+    CircleCoverage* table = &g_circleCoverage;
+    double r    = (double)radius / AA_ONE;
+    i32    size = (radius + AA_ONE - 1) >> AA_SUBPIXEL_BITS;
+    i32    rows = 2*size + 1;
+    table->size  = size;
+    table->pitch = rows + 8;
+    usize tileSize = (usize)(rows*table->pitch);
+    memset(table->coverage, 0, sizeof(table->coverage));
+
+    for (i32 phaseY = 0; phaseY <= CIRCLE_PHASES; phaseY++) {
+        for (i32 phaseX = 0; phaseX <= CIRCLE_PHASES; phaseX++) {
+            u8*    tile    = &table->coverage[(usize)(phaseY*(CIRCLE_PHASES + 1) + phaseX)*tileSize];
+            double centerX = (double)phaseX / CIRCLE_PHASES;
+            double centerY = (double)phaseY / CIRCLE_PHASES;
+            for (i32 row = 0; row < rows; row++) {
+                double top    = row - size - centerY;
+                double bottom = top + 1;
+                double left   = -size - centerX;
+                double area   = circleCornerArea(left, bottom, r) - circleCornerArea(left, top, r);
+                for (i32 column = 0; column < rows; column++) {
+                    double right    = left + 1;
+                    double nextArea = circleCornerArea(right, bottom, r) - circleCornerArea(right, top, r);
+                    i32    coverage = (i32)lround((nextArea - area)*255);
+                    tile[row*table->pitch + 4 + column] = (u8)min(max(coverage, 0), 255);
+                    area = nextArea;
+                    left = right;
+                }
+            }
+        }
+    }
+
+    for (i32 phaseY = 0; phaseY < CIRCLE_PHASES; phaseY++) {
+        for (i32 phaseX = 0; phaseX < CIRCLE_PHASES; phaseX++) {
+            u8* corners[4];
+            corners[0] = &table->coverage[(usize)(phaseY*(CIRCLE_PHASES + 1) + phaseX)*tileSize + 4 + size];
+            corners[1] = corners[0] + tileSize;
+            corners[2] = corners[0] + (CIRCLE_PHASES + 1)*tileSize;
+            corners[3] = corners[2] + tileSize;
+            for (i32 row = 0; row < rows; row++) {
+                i32 edgeStart = size + 1;
+                i32 edgeEnd   = -size;
+                i32 spanStart = size + 1;
+                i32 spanEnd   = -size;
+                for (i32 x = -size; x <= size; x++) {
+                    i32 covered = 0;
+                    i32 solid   = 0;
+                    for (u32 i = 0; i < 4; i++) {
+                        u8 coverage = corners[i][row*table->pitch + x];
+                        covered += coverage > 0 ? 1 : 0;
+                        solid   += coverage == 255 ? 1 : 0;
+                    }
+                    if (covered > 0) {
+                        edgeStart = min(edgeStart, x);
+                        edgeEnd   = max(edgeEnd, x + 1);
+                    }
+                    if (solid == 4) {
+                        spanStart = min(spanStart, x);
+                        spanEnd   = max(spanEnd, x + 1);
+                    }
+                }
+                if (edgeStart >= edgeEnd) {
+                    edgeStart = edgeEnd = 0;
+                }
+                if (spanStart >= spanEnd) {
+                    // an empty span splits the edge pixels in two halves
+                    spanStart = spanEnd = (edgeStart + edgeEnd) / 2;
+                }
+                table->spans[(phaseY*CIRCLE_PHASES + phaseX)*rows + row] = {
+                    (i8)edgeStart, (i8)spanStart, (i8)spanEnd, (i8)edgeEnd,
+                };
+            }
+        }
+    }
+    table->radius = radius;
+}
+
+// Coverage of eight pixels as 0..AA_ONE, the four from offset left and the
+// four from offset right, interpolated between the four phases around the
+// center. weightX and weightY are how far the center is past the phases, in
+// 1/128.
+static __m128i interpolateCircleCoverage(u8** corners, i32 left, i32 right, __m128i weightX, __m128i weightY) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i half = _mm_set1_epi16(64);
+    __m128i coverage[4];
+    for (u32 i = 0; i < 4; i++) {
+        u32 leftBytes, rightBytes;
+        memcpy(&leftBytes, corners[i] + left, sizeof(u32));
+        memcpy(&rightBytes, corners[i] + right, sizeof(u32));
+        coverage[i] = _mm_unpacklo_epi8(_mm_unpacklo_epi32(_mm_cvtsi32_si128((int)leftBytes),
+                                                           _mm_cvtsi32_si128((int)rightBytes)), zero);
+    }
+    // a + ((b - a)*weight + 64) >> 7, rounded
+    __m128i top    = _mm_sub_epi16(coverage[1], coverage[0]);
+    __m128i bottom = _mm_sub_epi16(coverage[3], coverage[2]);
+    top    = _mm_add_epi16(coverage[0], _mm_srai_epi16(_mm_add_epi16(_mm_mullo_epi16(top, weightX), half), 7));
+    bottom = _mm_add_epi16(coverage[2], _mm_srai_epi16(_mm_add_epi16(_mm_mullo_epi16(bottom, weightX), half), 7));
+    __m128i result = _mm_sub_epi16(bottom, top);
+    result = _mm_add_epi16(top, _mm_srai_epi16(_mm_add_epi16(_mm_mullo_epi16(result, weightY), half), 7));
+    // 255 becomes AA_ONE
+    return _mm_add_epi16(result, _mm_srli_epi16(result, 7));
+}
+
+// color*coverage + dst*(1 - alpha*coverage) for the four pixels of dst,
+// coverage and its inverse already repeated for their channels
+static __m128i blendCoverageHalves(__m128i color16, __m128i coverageLo, __m128i inverseLo,
+                                   __m128i coverageHi, __m128i inverseHi, __m128i dst) {
+    __m128i zero  = _mm_setzero_si128();
+    __m128i round = _mm_set1_epi16(AA_ONE/2);
+    __m128i lo = _mm_adds_epu16(_mm_adds_epu16(_mm_mullo_epi16(color16, coverageLo), round),
+                                _mm_mullo_epi16(_mm_unpacklo_epi8(dst, zero), inverseLo));
+    __m128i hi = _mm_adds_epu16(_mm_adds_epu16(_mm_mullo_epi16(color16, coverageHi), round),
+                                _mm_mullo_epi16(_mm_unpackhi_epi8(dst, zero), inverseHi));
+    return _mm_packus_epi16(_mm_srli_epi16(lo, AA_SUBPIXEL_BITS), _mm_srli_epi16(hi, AA_SUBPIXEL_BITS));
+}
+
+// Blends color over the four pixels of left and the four of right by eight
+// 0..AA_ONE coverages in 16 bits
+static void blendCoverage8(__m128i coverage, u32 color, __m128i* left, __m128i* right) {
+    __m128i color16 = _mm_unpacklo_epi8(_mm_set1_epi32((int)color), _mm_setzero_si128());
+    i16     alpha   = (i16)((color >> 24) + (color >> 31));
+    // coverage*alpha >> 8 without overflowing 16 bits at AA_ONE*AA_ONE
+    __m128i inverse = _mm_sub_epi16(_mm_set1_epi16(AA_ONE),
+                                    _mm_mulhi_epu16(_mm_slli_epi16(coverage, 7), _mm_set1_epi16((i16)(alpha << 1))));
+    __m128i coverageLo = _mm_unpacklo_epi16(coverage, coverage);
+    __m128i coverageHi = _mm_unpackhi_epi16(coverage, coverage);
+    __m128i inverseLo  = _mm_unpacklo_epi16(inverse, inverse);
+    __m128i inverseHi  = _mm_unpackhi_epi16(inverse, inverse);
+    *left  = blendCoverageHalves(color16, _mm_unpacklo_epi32(coverageLo, coverageLo), _mm_unpacklo_epi32(inverseLo, inverseLo),
+                                 _mm_unpackhi_epi32(coverageLo, coverageLo), _mm_unpackhi_epi32(inverseLo, inverseLo), *left);
+    *right = blendCoverageHalves(color16, _mm_unpacklo_epi32(coverageHi, coverageHi), _mm_unpacklo_epi32(inverseHi, inverseHi),
+                                 _mm_unpackhi_epi32(coverageHi, coverageHi), _mm_unpackhi_epi32(inverseHi, inverseHi), *right);
+}
+
+// interpolateCircleCoverage and blendCoverage8 for a single pixel, to the
+// same bits
+static u32 blendCirclePixel(u8** corners, i32 offset, i32 weightX, i32 weightY, u32 color, u32 dst) {
+    i32 top      = corners[0][offset] + (((corners[1][offset] - corners[0][offset])*weightX + 64) >> 7);
+    i32 bottom   = corners[2][offset] + (((corners[3][offset] - corners[2][offset])*weightX + 64) >> 7);
+    i32 coverage = top + (((bottom - top)*weightY + 64) >> 7);
+    coverage += coverage >> 7;
+    u32 alpha   = (color >> 24) + (color >> 31);
+    u32 inverse = AA_ONE - (((u32)coverage*alpha) >> AA_SUBPIXEL_BITS);
+    u32 result  = 0;
+    for (u32 shift = 0; shift < 32; shift += 8) {
+        u32 channel = (((color >> shift) & 0xff)*(u32)coverage + AA_ONE/2 + ((dst >> shift) & 0xff)*inverse) >> AA_SUBPIXEL_BITS;
+        result |= (channel < 255 ? channel : 255) << shift;
+    }
+    return result;
+}
+
+// Rows are a solid span and the edge pixels beside it. Most rows have at
+// most four edge pixels on either side, those blend both sides in one go
+// while rows cut by the bitmap or with longer edges go pixel by pixel.
+static void drawCircleAA(u32 color, Vec2 center, float radius, Bitmap* bitmap) {
+    i32 cx    = (i32)(center.x * AA_ONE);
+    i32 cy    = (i32)(center.y * AA_ONE);
+    i32 reach = (i32)(radius * AA_ONE);
+    if (reach <= 0) {
+        return;
+    }
+    if (reach > CIRCLE_AA_MAX_RADIUS * AA_ONE) {
+        // too large for the table
+        drawCircle(color, center, radius, bitmap);
+        return;
+    }
+    if (g_circleCoverage.radius != reach) {
+        buildCircleCoverage(reach);
+    }
+
+    CircleCoverage* table   = &g_circleCoverage;
+    i32             size    = table->size;
+    i32             rows    = 2*size + 1;
+    int             width   = (int)bitmap->width;
+    int             centerX = cx >> AA_SUBPIXEL_BITS;
+    int             centerY = cy >> AA_SUBPIXEL_BITS;
+    int             minY    = max(centerY - size, 0);
+    int             maxY    = min(centerY + size + 1, (int)bitmap->height);
+
+    // the phases at or before the center and how far it is past them
+    constexpr i32 PHASE_SHIFT = AA_SUBPIXEL_BITS - CIRCLE_PHASE_BITS;
+    i32     phaseX  = (cx >> PHASE_SHIFT) & (CIRCLE_PHASES - 1);
+    i32     phaseY  = (cy >> PHASE_SHIFT) & (CIRCLE_PHASES - 1);
+    i32     weightX = (cx & ((1 << PHASE_SHIFT) - 1)) << (7 - PHASE_SHIFT);
+    i32     weightY = (cy & ((1 << PHASE_SHIFT) - 1)) << (7 - PHASE_SHIFT);
+
+    usize tileSize = (usize)(rows*table->pitch);
+    u8*   corners[4];
+    corners[0] = &table->coverage[(usize)(phaseY*(CIRCLE_PHASES + 1) + phaseX)*tileSize + 4 + size];
+    corners[1] = corners[0] + tileSize;
+    corners[2] = corners[0] + (CIRCLE_PHASES + 1)*tileSize;
+    corners[3] = corners[2] + tileSize;
+    CircleSpan* spans = &table->spans[(phaseY*CIRCLE_PHASES + phaseX)*rows];
+
+    for (int y = minY; y < maxY; y++) {
+        i32        row  = y - centerY + size;
+        CircleSpan span = spans[row];
+        if (span.edgeStart == span.edgeEnd) {
+            continue;
+        }
+
+        u32* pixels    = &bitmap->data[y * bitmap->width];
+        i32  rowOffset = row*table->pitch;
+        int  spanStart = centerX + span.spanStart;
+        int  spanEnd   = centerX + span.spanEnd;
+        if (span.spanStart - span.edgeStart <= 4 && span.edgeEnd - span.spanEnd <= 4 &&
+            spanStart >= 4 && spanEnd + 4 <= width) {
+            __m128i coverage = interpolateCircleCoverage(corners, rowOffset + span.spanStart - 4, rowOffset + span.spanEnd,
+                                                         _mm_set1_epi16((i16)weightX), _mm_set1_epi16((i16)weightY));
+            __m128i left     = _mm_loadu_si128((__m128i*)(pixels + spanStart - 4));
+            __m128i right    = _mm_loadu_si128((__m128i*)(pixels + spanEnd));
+            blendCoverage8(coverage, color, &left, &right);
+            // the span is filled four pixels at a time, what it writes past
+            // its end is covered by the right edge stored after it
+            fillSpan(pixels + spanStart, (spanEnd - spanStart + 3) & ~3, color);
+            _mm_storeu_si128((__m128i*)(pixels + spanStart - 4), left);
+            _mm_storeu_si128((__m128i*)(pixels + spanEnd), right);
+        } else {
+            int edgeStart = max(centerX + span.edgeStart, 0);
+            int edgeEnd   = min(centerX + span.edgeEnd, width);
+            spanStart = min(max(spanStart, edgeStart), edgeEnd);
+            spanEnd   = min(max(spanEnd, spanStart), edgeEnd);
+            fillSpan(pixels + spanStart, spanEnd - spanStart, color);
+            for (int x = edgeStart; x < edgeEnd; x++) {
+                if (x < spanStart || x >= spanEnd) {
+                    pixels[x] = blendCirclePixel(corners, rowOffset + x - centerX, weightX, weightY, color, pixels[x]);
+                }
+            }
+        }
+    }
+}
+
+// t is 0..256
+static u32 lerpPixel(u32 a, u32 b, u32 t) {
+    u32 rb = ((a & 0x00ff00ff) * (256 - t) + (b & 0x00ff00ff) * t) >> 8;
+    u32 ag = ((a >> 8) & 0x00ff00ff) * (256 - t) + ((b >> 8) & 0x00ff00ff) * t;
+    return (rb & 0x00ff00ff) | (ag & 0xff00ff00);
+}
+
+// u and v are 16.16 texel coordinates inside region, texel centers at +0.5
+static u32 sampleBilinear(Bitmap* image, BitmapRegion region, i32 u, i32 v) {
+    i32 x0 = u >> 16;
+    i32 y0 = v >> 16;
+    u32 fx = (u32)(u & 0xffff) >> 8;
+    u32 fy = (u32)(v & 0xffff) >> 8;
+    i32 x1 = min(x0 + 1, (i32)region.width  - 1);
+    i32 y1 = min(y0 + 1, (i32)region.height - 1);
+    x0 = max(0, min(x0, (i32)region.width  - 1));
+    y0 = max(0, min(y0, (i32)region.height - 1));
+    x1 = max(0, x1);
+    y1 = max(0, y1);
+
+    u32* row0 = image->data + (region.y + y0) * image->width + region.x;
+    u32* row1 = image->data + (region.y + y1) * image->width + region.x;
+    u32 top    = lerpPixel(row0[x0], row0[x1], fx);
+    u32 bottom = lerpPixel(row1[x0], row1[x1], fx);
+    return lerpPixel(top, bottom, fy);
+}
+
+// Draws region of image scaled to cover [dstMin, dstMin+dstSize), alpha blended.
+static void blitBitmap(Bitmap* bitmap, Vec2 dstMin, Vec2 dstSize,
+                       Bitmap* image, BitmapRegion region, BlitFilter filter) {
+    if (region.width == 0 || region.height == 0 || dstSize.x <= 0 || dstSize.y <= 0) {
+        return;
+    }
+
+    // a pixel is covered when its center is inside the destination rectangle
+    int minX = (int)ceilf(dstMin.x - 0.5f);
+    int minY = (int)ceilf(dstMin.y - 0.5f);
+    int maxX = (int)ceilf(dstMin.x + dstSize.x - 0.5f);
+    int maxY = (int)ceilf(dstMin.y + dstSize.y - 0.5f);
+
+    if (minX >= (int)bitmap->width || minY >= (int)bitmap->height ||
+        maxX <= 0 || maxY <= 0) {
+        return;
+    }
+
+    int clippedMinX = max(minX, 0);
+    int clippedMinY = max(minY, 0);
+    maxX = min(maxX, (int)bitmap->width);
+    maxY = min(maxY, (int)bitmap->height);
+    if (clippedMinX >= maxX || clippedMinY >= maxY) {
+        return;
+    }
+
+    float scaleX = region.width  / dstSize.x;
+    float scaleY = region.height / dstSize.y;
+    // source coordinate of the first covered pixel center, in 16.16
+    i32 stepU = (i32)(scaleX * 65536.0f);
+    i32 stepV = (i32)(scaleY * 65536.0f);
+    i32 startU = (i32)(((clippedMinX + 0.5f - dstMin.x) * scaleX) * 65536.0f);
+    i32 startV = (i32)(((clippedMinY + 0.5f - dstMin.y) * scaleY) * 65536.0f);
+    int count = maxX - clippedMinX;
+
+    if (filter == BLIT_NEAREST && region.width == (u32)(maxX - minX) && stepU == 65536 &&
+        dstMin.x == (float)minX) {
+        // unscaled rows can be blended straight from the source
+        u32 offsetX = region.x + (u32)(clippedMinX - minX);
+        i32 v = startV;
+        for (int y = clippedMinY; y < maxY; y++, v += stepV) {
+            u32 sy = region.y + (u32)max(0, min(v >> 16, (i32)region.height - 1));
+            blendSpan(&bitmap->data[y * bitmap->width + clippedMinX],
+                      &image->data[sy * image->width + offsetX], count);
+        }
+        return;
+    }
+
+    i32 lastX = (i32)region.width  - 1;
+    i32 lastY = (i32)region.height - 1;
+    i32 v = startV;
+    for (int y = clippedMinY; y < maxY; y++, v += stepV) {
+        u32* p = &bitmap->data[y * bitmap->width + clippedMinX];
+        u32 samples[4];
+        i32 u = startU;
+        int x = 0;
+        if (filter == BLIT_NEAREST) {
+            u32* row = image->data + (region.y + max(0, min(v >> 16, lastY))) * image->width + region.x;
+            for (; x + 4 <= count; x += 4) {
+                for (int i = 0; i < 4; i++, u += stepU) {
+                    samples[i] = row[max(0, min(u >> 16, lastX))];
+                }
+                __m128i d = _mm_loadu_si128((__m128i*)(p + x));
+                __m128i s = _mm_loadu_si128((__m128i*)samples);
+                _mm_storeu_si128((__m128i*)(p + x), blendPremultiplied4(s, d));
+            }
+            for (; x < count; x++, u += stepU) {
+                p[x] = blendPremultiplied(row[max(0, min(u >> 16, lastX))], p[x]);
+            }
+        } else {
+            // bilinear taps are centered on texel centers
+            i32 tapV = v - 32768;
+            u -= 32768;
+            for (; x + 4 <= count; x += 4) {
+                for (int i = 0; i < 4; i++, u += stepU) {
+                    samples[i] = sampleBilinear(image, region, u, tapV);
+                }
+                __m128i d = _mm_loadu_si128((__m128i*)(p + x));
+                __m128i s = _mm_loadu_si128((__m128i*)samples);
+                _mm_storeu_si128((__m128i*)(p + x), blendPremultiplied4(s, d));
+            }
+            for (; x < count; x++, u += stepU) {
+                p[x] = blendPremultiplied(sampleBilinear(image, region, u, tapV), p[x]);
+            }
+        }
+    }
+}
+
+static void drawBitmap(Bitmap* image, Vec2 center, Vec2 halfSize, Bitmap* bitmap,
+                       BlitFilter filter = BLIT_BILINEAR) {
+    BitmapRegion region = {0, 0, image->width, image->height};
+    blitBitmap(bitmap, center - halfSize, 2*halfSize, image, region, filter);
+}
+
+// Placement of a fixed resolution image inside an output bitmap, keeping
+// the aspect ratio and leaving black bars on the remaining sides.
+struct ScaleLayout {
+    u32  srcWidth;
+    u32  srcHeight;
+    u32  dstX;
+    u32  dstY;
+    u32  dstWidth;
+    u32  dstHeight;
+    u32  integerScale; // 0 when the image is not scaled by a whole number
+    u32* columnMap;    // source column of every destination column
+};
+
+// columnMap needs room for outputWidth entries
+static void computeScaleLayout(ScaleLayout* layout, u32 srcWidth, u32 srcHeight,
+                               u32 outputWidth, u32 outputHeight, u32* columnMap) {
+    *layout = {};
+    layout->srcWidth  = srcWidth;
+    layout->srcHeight = srcHeight;
+    layout->columnMap = columnMap;
+    if (outputWidth == 0 || outputHeight == 0) {
+        return;
+    }
+
+    if ((u64)outputWidth * srcHeight <= (u64)outputHeight * srcWidth) {
+        layout->dstWidth  = outputWidth;
+        layout->dstHeight = max(1, (i32)((u64)outputWidth * srcHeight / srcWidth));
+    } else {
+        layout->dstWidth  = max(1, (i32)((u64)outputHeight * srcWidth / srcHeight));
+        layout->dstHeight = outputHeight;
+    }
+    layout->dstX = (outputWidth  - layout->dstWidth)  / 2;
+    layout->dstY = (outputHeight - layout->dstHeight) / 2;
+
+    if (layout->dstWidth % srcWidth == 0 && layout->dstWidth / srcWidth == layout->dstHeight / srcHeight &&
+        layout->dstHeight % srcHeight == 0) {
+        layout->integerScale = layout->dstWidth / srcWidth;
+    }
+    for (u32 x = 0; x < layout->dstWidth; x++) {
+        columnMap[x] = (u32)(((u64)(2*x + 1) * srcWidth) / (2 * (u64)layout->dstWidth));
+    }
+}
+
+static void scaleRowInteger(u32* dst, u32* src, u32 srcWidth, u32 scale) {
+    if (scale == 1) {
+        memcpy(dst, src, sizeof(u32) * srcWidth);
+        return;
+    }
+
+    u32 x = 0;
+    if (scale == 2) {
+        for (; x + 4 <= srcWidth; x += 4) {
+            __m128i v = _mm_loadu_si128((__m128i*)(src + x));
+            _mm_storeu_si128((__m128i*)(dst + 2*x),     _mm_unpacklo_epi32(v, v));
+            _mm_storeu_si128((__m128i*)(dst + 2*x + 4), _mm_unpackhi_epi32(v, v));
+        }
+    } else {
+        // every store may spill up to 3 pixels into the next run, which the
+        // next pixel overwrites, so only the last pixel needs exact stores
+        for (; x + 1 < srcWidth; x++) {
+            __m128i v = _mm_set1_epi32((int)src[x]);
+            u32* d = dst + x*scale;
+            for (u32 k = 0; k < scale; k += 4) {
+                _mm_storeu_si128((__m128i*)(d + k), v);
+            }
+        }
+    }
+    for (; x < srcWidth; x++) {
+        for (u32 k = 0; k < scale; k++) {
+            dst[x*scale + k] = src[x];
+        }
+    }
+}
+
+static void clearRect(Bitmap* bitmap, u32 minX, u32 minY, u32 maxX, u32 maxY, u32 color) {
+    for (u32 y = minY; y < maxY; y++) {
+        u32* p = &bitmap->data[y * bitmap->width];
+        for (u32 x = minX; x < maxX; x++) {
+            p[x] = color;
+        }
+    }
+}
+
+// Nearest neighbour scaling of image into output as described by layout.
+static void presentScaled(Bitmap* image, Bitmap* output, ScaleLayout* layout) {
+    ASSERT(image->width == layout->srcWidth && image->height == layout->srcHeight);
+    u32 dstMaxX = layout->dstX + layout->dstWidth;
+    u32 dstMaxY = layout->dstY + layout->dstHeight;
+    ASSERT(dstMaxX <= output->width && dstMaxY <= output->height);
+
+    clearRect(output, 0, 0, output->width, layout->dstY, 0xff000000);
+    clearRect(output, 0, dstMaxY, output->width, output->height, 0xff000000);
+    clearRect(output, 0, layout->dstY, layout->dstX, dstMaxY, 0xff000000);
+    clearRect(output, dstMaxX, layout->dstY, output->width, dstMaxY, 0xff000000);
+
+    if (layout->integerScale) {
+        u32 scale = layout->integerScale;
+        for (u32 y = 0; y < image->height; y++) {
+            u32* first = &output->data[(layout->dstY + y*scale) * output->width + layout->dstX];
+            scaleRowInteger(first, &image->data[y * image->width], image->width, scale);
+            for (u32 k = 1; k < scale; k++) {
+                memcpy(first + k*output->width, first, sizeof(u32) * layout->dstWidth);
+            }
+        }
+        return;
+    }
+
+    u32  lastSourceRow = ~0u;
+    u32* lastRow       = NULL;
+    for (u32 y = 0; y < layout->dstHeight; y++) {
+        u32  sy  = (u32)(((u64)(2*y + 1) * image->height) / (2 * (u64)layout->dstHeight));
+        u32* dst = &output->data[(layout->dstY + y) * output->width + layout->dstX];
+        if (sy == lastSourceRow) {
+            memcpy(dst, lastRow, sizeof(u32) * layout->dstWidth);
+            continue;
+        }
+
+        u32* src = &image->data[sy * image->width];
+        u32* map = layout->columnMap;
+        u32 x = 0;
+        for (; x + 4 <= layout->dstWidth; x += 4) {
+            __m128i v = _mm_setr_epi32((int)src[map[x]], (int)src[map[x + 1]],
+                                       (int)src[map[x + 2]], (int)src[map[x + 3]]);
+            _mm_storeu_si128((__m128i*)(dst + x), v);
+        }
+        for (; x < layout->dstWidth; x++) {
+            dst[x] = src[map[x]];
+        }
+        lastSourceRow = sy;
+        lastRow       = dst;
+    }
+}
+
+// 8-bit render target. Draw calls write palette indices, expandIndexed turns
+// them into 0xAARRGGBB once per frame, so changing the palette recolors the
+// whole frame for free. It exists for palette effects, not for speed: the
+// expansion writes the same 32-bit frame the full color path draws, and
+// costs about as much as the drawing the smaller pixels save.
+struct IndexedBitmap {
+    u8* data;
+    u32 width;
+    u32 height;
+};
+
+struct Palette {
+    u32 colors[256];
+};
+
+static IndexedBitmap* allocateIndexedBitmap(Arena* arena, u32 width, u32 height) {
+    IndexedBitmap* bitmap = push(arena, IndexedBitmap);
+    if (!bitmap) {
+        return NULL;
+    }
+    bitmap->data   = (u8*)allocate(arena, (usize)width*height, 16);
+    bitmap->width  = width;
+    bitmap->height = height;
+    return bitmap->data ? bitmap : NULL;
+}
+
+static void clearIndexed(IndexedBitmap* bitmap, u8 index) {
+    memset(bitmap->data, index, (usize)bitmap->width*bitmap->height);
+}
+
+static void drawSquareIndexed(u8 index, Vec2 center, Vec2 halfSize, IndexedBitmap* bitmap) {
+    int minX = (int)(center.x - halfSize.x);
+    int minY = (int)(center.y - halfSize.y);
+    int maxX = (int)(center.x + halfSize.x) + 1;
+    int maxY = (int)(center.y + halfSize.y) + 1;
+
+    if (minX >= (int)bitmap->width || minY >= (int)bitmap->height ||
+        maxX <= 0 || maxY <= 0) {
+        return;
+    }
+
+    minX = minX >= 0 ? minX : 0;
+    minY = minY >= 0 ? minY : 0;
+    maxX = maxX <= (int)bitmap->width  ? maxX : (int)bitmap->width;
+    maxY = maxY <= (int)bitmap->height ? maxY : (int)bitmap->height;
+
+    for (int y = minY; y < maxY; y++) {
+        memset(&bitmap->data[y * bitmap->width + minX], index, maxX - minX);
+    }
+}
+
+static void drawCircleIndexed(u8 index, Vec2 center, float radius, IndexedBitmap* bitmap) {
+    int minX = (int)(center.x - radius);
+    int minY = (int)(center.y - radius);
+    int maxX = (int)(center.x + radius) + 1;
+    int maxY = (int)(center.y + radius) + 1;
+
+    if (minX >= (int)bitmap->width || minY >= (int)bitmap->height ||
+        maxX < 0 || maxY < 0) {
+        return;
+    }
+
+    minX = minX >= 0 ? minX : 0;
+    minY = minY >= 0 ? minY : 0;
+    maxX = maxX <= (int)bitmap->width  ? maxX : (int)bitmap->width;
+    maxY = maxY <= (int)bitmap->height ? maxY : (int)bitmap->height;
+
+    for (int y = minY; y < maxY; y++) {
+        u8* p = &bitmap->data[y * bitmap->width + minX];
+        for (int x = minX; x < maxX; x++) {
+            Vec2 d = vec2(x,y) - center;
+            if (dot(d,d) <= radius*radius) {
+                *p = index;
+            }
+            p++;
+        }
+    }
+}
+
+static void expandIndexedRow(u32* dst, u8* src, u32 count, Palette* palette) {
+    u32 x = 0;
+#if defined(__SSSE3__)
+    // The first 16 colors split into one byte plane per channel, so pshufb
+    // looks up 16 pixels per channel at once. Blocks that use higher
+    // indices fall back to the table.
+    __m128i colorsLo = _mm_loadu_si128((__m128i*)&palette->colors[0]);
+    __m128i colorsA  = _mm_loadu_si128((__m128i*)&palette->colors[4]);
+    __m128i colorsB  = _mm_loadu_si128((__m128i*)&palette->colors[8]);
+    __m128i colorsHi = _mm_loadu_si128((__m128i*)&palette->colors[12]);
+    // gather byte k of every color into lane group k: b0..b3 g0..g3 r0..r3 a0..a3 per 4 colors
+    __m128i byChannel = _mm_setr_epi8(0,4,8,12, 1,5,9,13, 2,6,10,14, 3,7,11,15);
+    __m128i q0 = _mm_shuffle_epi8(colorsLo, byChannel);
+    __m128i q1 = _mm_shuffle_epi8(colorsA,  byChannel);
+    __m128i q2 = _mm_shuffle_epi8(colorsB,  byChannel);
+    __m128i q3 = _mm_shuffle_epi8(colorsHi, byChannel);
+    __m128i t0 = _mm_unpacklo_epi32(q0, q1); // b0-3 b4-7 g0-3 g4-7
+    __m128i t1 = _mm_unpackhi_epi32(q0, q1); // r0-3 r4-7 a0-3 a4-7
+    __m128i t2 = _mm_unpacklo_epi32(q2, q3);
+    __m128i t3 = _mm_unpackhi_epi32(q2, q3);
+    __m128i planeB = _mm_unpacklo_epi64(t0, t2);
+    __m128i planeG = _mm_unpackhi_epi64(t0, t2);
+    __m128i planeR = _mm_unpacklo_epi64(t1, t3);
+    __m128i planeA = _mm_unpackhi_epi64(t1, t3);
+
+    __m128i maxFastIndex = _mm_set1_epi8(15);
+    __m128i zero         = _mm_setzero_si128();
+    for (; x + 16 <= count; x += 16) {
+        __m128i indices = _mm_loadu_si128((__m128i*)(src + x));
+        __m128i tooHigh = _mm_subs_epu8(indices, maxFastIndex);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(tooHigh, zero)) != 0xffff) {
+            for (u32 i = x; i < x + 16; i++) {
+                dst[i] = palette->colors[src[i]];
+            }
+            continue;
+        }
+
+        __m128i b = _mm_shuffle_epi8(planeB, indices);
+        __m128i g = _mm_shuffle_epi8(planeG, indices);
+        __m128i r = _mm_shuffle_epi8(planeR, indices);
+        __m128i a = _mm_shuffle_epi8(planeA, indices);
+        __m128i bgLo = _mm_unpacklo_epi8(b, g);
+        __m128i bgHi = _mm_unpackhi_epi8(b, g);
+        __m128i raLo = _mm_unpacklo_epi8(r, a);
+        __m128i raHi = _mm_unpackhi_epi8(r, a);
+        _mm_storeu_si128((__m128i*)(dst + x),      _mm_unpacklo_epi16(bgLo, raLo));
+        _mm_storeu_si128((__m128i*)(dst + x + 4),  _mm_unpackhi_epi16(bgLo, raLo));
+        _mm_storeu_si128((__m128i*)(dst + x + 8),  _mm_unpacklo_epi16(bgHi, raHi));
+        _mm_storeu_si128((__m128i*)(dst + x + 12), _mm_unpackhi_epi16(bgHi, raHi));
+    }
+#endif
+    for (; x < count; x++) {
+        dst[x] = palette->colors[src[x]];
+    }
+}
+
+static void expandIndexed(IndexedBitmap* image, Palette* palette, Bitmap* bitmap) {
+    ASSERT(image->width == bitmap->width && image->height == bitmap->height);
+    for (u32 y = 0; y < image->height; y++) {
+        expandIndexedRow(&bitmap->data[y * bitmap->width], &image->data[y * image->width],
+                         image->width, palette);
+    }
+}
+
+#pragma pack(push, 1)
+struct BmpFileHeader {
+    u16 type;       // "BM"
+    u32 size;
+    u16 reserved1;
+    u16 reserved2;
+    u32 dataOffset;
+};
+
+struct BmpInfoHeader {
+    u32 size;       // 40 for BITMAPINFOHEADER, 108 for V4, 124 for V5
+    i32 width;
+    i32 height;     // negative for top-down images
+    u16 planes;
+    u16 bitCount;
+    u32 compression;
+    u32 imageSize;
+    i32 xPixelsPerMeter;
+    i32 yPixelsPerMeter;
+    u32 colorsUsed;
+    u32 colorsImportant;
+    // BI_BITFIELDS masks, stored right after the 40 byte header or inside V4/V5 headers
+    u32 redMask;
+    u32 greenMask;
+    u32 blueMask;
+    u32 alphaMask;  // only present in V3 headers and later
+};
+
+struct TgaHeader {
+    u8  idLength;
+    u8  colorMapType;
+    u8  imageType;  // 2 truecolor, 10 run length encoded truecolor
+    u16 colorMapFirst;
+    u16 colorMapLength;
+    u8  colorMapDepth;
+    u16 xOrigin;
+    u16 yOrigin;
+    u16 width;
+    u16 height;
+    u8  pixelDepth;
+    u8  descriptor; // bit 5 set for top-down images
+};
+#pragma pack(pop)
+
+static constexpr u32 BMP_BI_RGB       = 0;
+static constexpr u32 BMP_BI_BITFIELDS = 3;
+
+static u32 premultiplyAlpha(u32 r, u32 g, u32 b, u32 a) {
+    r = (r * a + 127) / 255;
+    g = (g * a + 127) / 255;
+    b = (b * a + 127) / 255;
+    return (a << 24) | (r << 16) | (g << 8) | b;
+}
+
+static Bitmap* allocateBitmap(Arena* arena, u32 width, u32 height) {
+    Bitmap* bitmap = push(arena, Bitmap);
+    u32*    data   = (u32*)allocate(arena, sizeof(u32) * width*height, 16);
+    if (!bitmap || !data) {
+        return NULL;
+    }
+    bitmap->data   = data;
+    bitmap->width  = width;
+    bitmap->height = height;
+    return bitmap;
+}
+
+static u32 extractMasked(u32 pixel, u32 mask) {
+    return mask ? (pixel & mask) >> countTrailingZeros(mask) : 0;
+}
+
+static Bitmap* decodeBmp(Arena* arena, u8* buffer, usize size) {
+    BmpFileHeader* fileHeader = (BmpFileHeader*)buffer;
+    BmpInfoHeader* info       = (BmpInfoHeader*)(buffer + sizeof(BmpFileHeader));
+    if (size < sizeof(BmpFileHeader) + 40 || info->size < 40 ||
+        info->width <= 0 || info->height == 0) {
+        LOG("Unsupported BMP header\n");
+        return NULL;
+    }
+
+    u32 redMask   = 0x00ff0000;
+    u32 greenMask = 0x0000ff00;
+    u32 blueMask  = 0x000000ff;
+    u32 alphaMask = 0;
+    if (info->compression == BMP_BI_BITFIELDS && info->bitCount == 32 &&
+        size >= sizeof(BmpFileHeader) + 56) {
+        redMask   = info->redMask;
+        greenMask = info->greenMask;
+        blueMask  = info->blueMask;
+        alphaMask = info->size >= 56 ? info->alphaMask : 0;
+    } else if (info->compression != BMP_BI_RGB || (info->bitCount != 24 && info->bitCount != 32)) {
+        LOG("Unsupported BMP format, only 24 and 32 bit uncompressed images are supported\n");
+        return NULL;
+    }
+    if (popCount(redMask) != 8 || popCount(greenMask) != 8 || popCount(blueMask) != 8 ||
+        (alphaMask && popCount(alphaMask) != 8)) {
+        LOG("Unsupported BMP channel masks\n");
+        return NULL;
+    }
+
+    u32  width   = (u32)info->width;
+    u32  height  = (u32)(info->height > 0 ? info->height : -info->height);
+    bool topDown = info->height < 0;
+    u32  bytesPerPixel = info->bitCount / 8;
+    u32  stride  = (width * bytesPerPixel + 3) & ~3u;
+    if (fileHeader->dataOffset + (usize)stride * height > size) {
+        LOG("BMP pixel data is truncated\n");
+        return NULL;
+    }
+
+    Bitmap* bitmap = allocateBitmap(arena, width, height);
+    if (!bitmap) {
+        return NULL;
+    }
+
+    for (u32 y = 0; y < height; y++) {
+        u8*  src = buffer + fileHeader->dataOffset + (usize)stride * (topDown ? y : height - 1 - y);
+        u32* dst = bitmap->data + y * width;
+        for (u32 x = 0; x < width; x++) {
+            u32 pixel = src[0] | (src[1] << 8) | (src[2] << 16);
+            if (bytesPerPixel == 4) {
+                pixel |= (u32)src[3] << 24;
+            }
+            src += bytesPerPixel;
+
+            u32 a = alphaMask ? extractMasked(pixel, alphaMask) : 255;
+            dst[x] = premultiplyAlpha(extractMasked(pixel, redMask),
+                                      extractMasked(pixel, greenMask),
+                                      extractMasked(pixel, blueMask), a);
+        }
+    }
+    return bitmap;
+}
+
+static Bitmap* decodeTga(Arena* arena, u8* buffer, usize size) {
+    TgaHeader* header = (TgaHeader*)buffer;
+    if (size < sizeof(TgaHeader) || header->colorMapType != 0 ||
+        (header->imageType != 2 && header->imageType != 10) ||
+        (header->pixelDepth != 24 && header->pixelDepth != 32) ||
+        header->width == 0 || header->height == 0) {
+        LOG("Unsupported TGA format, only 24 and 32 bit truecolor images are supported\n");
+        return NULL;
+    }
+
+    u32  width   = header->width;
+    u32  height  = header->height;
+    bool topDown = (header->descriptor & 0x20) != 0;
+    u32  bytesPerPixel = header->pixelDepth / 8;
+
+    Bitmap* bitmap = allocateBitmap(arena, width, height);
+    if (!bitmap) {
+        return NULL;
+    }
+
+    u8* src = buffer + sizeof(TgaHeader) + header->idLength;
+    u8* end = buffer + size;
+    u32 packetCount = 0;
+    bool packetIsRun = false;
+    for (u32 i = 0; i < width*height; i++) {
+        if (header->imageType == 10 && packetCount == 0) {
+            if (src >= end) {
+                LOG("TGA pixel data is truncated\n");
+                return NULL;
+            }
+            packetIsRun = (*src & 0x80) != 0;
+            packetCount = (*src & 0x7f) + 1;
+            src++;
+        }
+        if (src + bytesPerPixel > end) {
+            LOG("TGA pixel data is truncated\n");
+            return NULL;
+        }
+
+        u32 a = bytesPerPixel == 4 ? src[3] : 255;
+        u32 y = i / width;
+        u32 x = i % width;
+        y = topDown ? y : height - 1 - y;
+        bitmap->data[y * width + x] = premultiplyAlpha(src[2], src[1], src[0], a);
+
+        if (header->imageType == 10) {
+            packetCount--;
+            if (!packetIsRun || packetCount == 0) {
+                src += bytesPerPixel;
+            }
+        } else {
+            src += bytesPerPixel;
+        }
+    }
+    return bitmap;
+}
+
+static Bitmap* decodeImage(Arena* arena, u8* buffer, usize size) {
+    if (size >= 2 && buffer[0] == 'B' && buffer[1] == 'M') {
+        return decodeBmp(arena, buffer, size);
+    }
+    return decodeTga(arena, buffer, size);
+}
+
+static Bitmap* readImageFile(Arena* arena, Arena* scratch, const char* fileName) {
+    FILE* file;
+    if (fopen_s(&file, fileName, "rb") != 0) {
+        LOG("Error opening %s\n", fileName);
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    u8* buffer = (u8*)allocate(scratch, (usize)size, 4);
+    fread(buffer, size, 1, file);
+    fclose(file);
+
+    Bitmap* bitmap = decodeImage(arena, buffer, (usize)size);
+    if (!bitmap) {
+        LOG("Error decoding %s\n", fileName);
+    }
+    return bitmap;
+}
+
+#endif // BREAKOUT_RENDER_H_
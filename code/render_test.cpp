@@ -0,0 +1,510 @@
+// Golden image test for the renderer: plays scripted games headless, renders
+// selected ticks at several bitmap sizes and compares a hash of every frame
+// with tests/render_golden.txt. Run it from the repository root.
+//
+// usage: render_test [--update] [--save-reference] [--bench]
+//
+// --update         rewrites the golden hashes from the current renderer
+// --save-reference writes every frame as render_test_<case>_expected.bmp
+// --bench          only times the aliased against the anti-aliased shapes
+//
+// A mismatching frame is written as render_test_<case>_actual.bmp. When the
+// expected image of that case was saved by a known good build before, a
+// render_test_<case>_diff.bmp marks the differing pixels in magenta.
+
+#include "base.h"
+#include "render.h"
+#include "text.h"
+#include "particles.h"
+#include "game.h"
+#include "scene.h"
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+static const char* GOLDEN_FILE_NAME = "tests/render_golden.txt";
+
+static constexpr u32 MAX_GOLDENS = 1024;
+
+struct TestSize {
+    u32 width;
+    u32 height;
+};
+
+// The native size, plus sizes that clip the playfield and leave odd SIMD tails
+static const TestSize TEST_SIZES[] = {
+    {WIDTH, HEIGHT},
+    {641, 359},
+    {1927, 1083},
+};
+
+enum TestMode {
+    TEST_FLAT,
+    TEST_SPRITES,
+    TEST_INDEXED,
+    TEST_ANTIALIASED,
+    TEST_MODE_COUNT,
+};
+
+static const char* TEST_MODE_NAMES[TEST_MODE_COUNT] = {"flat", "sprites", "indexed", "aa"};
+
+static const u32 CAPTURE_TICKS[] = {0, 60, 241, 600, 1203, 2400};
+
+struct Golden {
+    char name[64];
+    u64  hash;
+    bool seen;
+};
+
+struct GoldenSet {
+    Golden goldens[MAX_GOLDENS];
+    u32    count;
+};
+
+static u64 mixHash(u64 x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ull;
+    x ^= x >> 33;
+    return x;
+}
+
+// acc += swap(data) + lo32(data ^ key) * hi32(data ^ key), per 64-bit lane
+static __m128i hashAccumulate(__m128i acc, __m128i data, __m128i key) {
+    __m128i mixed   = _mm_xor_si128(data, key);
+    __m128i product = _mm_mul_epu32(mixed, _mm_shuffle_epi32(mixed, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_add_epi64(_mm_add_epi64(acc, product), _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2)));
+}
+
+// Multiply-accumulate hash over 32 bytes per step. The key advances with
+// every 16 bytes, so the same pixels at a different place hash differently.
+static u64 hashBitmap(Bitmap* bitmap) {
+    __m128i acc0 = _mm_set_epi64x((i64)0x9e3779b185ebca87ull, (i64)0xc2b2ae3d27d4eb4full);
+    __m128i acc1 = _mm_set_epi64x((i64)0x165667b19e3779f9ull, (i64)0x85ebca77c2b2ae63ull);
+    __m128i key  = _mm_setr_epi32(0x27d4eb2f, 0x165667b1, (int)0x85ebca6b, (int)0xc2b2ae35);
+    __m128i step = _mm_set1_epi32((int)0x9e3779b9);
+
+    u32* pixels = bitmap->data;
+    u32  count  = bitmap->width * bitmap->height;
+    u32  i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i key1 = _mm_add_epi32(key, step);
+        acc0 = hashAccumulate(acc0, _mm_loadu_si128((__m128i*)(pixels + i)), key);
+        acc1 = hashAccumulate(acc1, _mm_loadu_si128((__m128i*)(pixels + i + 4)), key1);
+        key  = _mm_add_epi32(key1, step);
+    }
+    if (i < count) {
+        u32 tail[8] = {};
+        memcpy(tail, pixels + i, sizeof(u32) * (count - i));
+        acc0 = hashAccumulate(acc0, _mm_loadu_si128((__m128i*)tail), key);
+        acc1 = hashAccumulate(acc1, _mm_loadu_si128((__m128i*)(tail + 4)), _mm_add_epi32(key, step));
+    }
+
+    u64 lanes[4];
+    _mm_storeu_si128((__m128i*)lanes, acc0);
+    _mm_storeu_si128((__m128i*)(lanes + 2), acc1);
+    u64 hash = mixHash(((u64)bitmap->width << 32) | bitmap->height);
+    for (u32 lane = 0; lane < 4; lane++) {
+        hash = mixHash(hash ^ lanes[lane]);
+    }
+    return hash;
+}
+
+static bool writeBmp(const char* fileName, Bitmap* bitmap) {
+    FILE* file;
+    if (fopen_s(&file, fileName, "wb") != 0) {
+        LOG("Error creating %s\n", fileName);
+        return false;
+    }
+
+    u32 dataSize = sizeof(u32) * bitmap->width*bitmap->height;
+    BmpFileHeader fileHeader = {};
+    fileHeader.type       = 'B' | ('M' << 8);
+    fileHeader.dataOffset = sizeof(BmpFileHeader) + 40;
+    fileHeader.size       = fileHeader.dataOffset + dataSize;
+    BmpInfoHeader info = {};
+    info.size      = 40;
+    info.width     = (i32)bitmap->width;
+    info.height    = -(i32)bitmap->height; // top-down
+    info.planes    = 1;
+    info.bitCount  = 32;
+    info.imageSize = dataSize;
+
+    fwrite(&fileHeader, sizeof(fileHeader), 1, file);
+    fwrite(&info, 40, 1, file);
+    fwrite(bitmap->data, dataSize, 1, file);
+    fclose(file);
+    return true;
+}
+
+static void loadGoldens(GoldenSet* set) {
+    set->count = 0;
+    FILE* file;
+    if (fopen_s(&file, GOLDEN_FILE_NAME, "rb") != 0) {
+        LOG("No golden hashes at %s yet\n", GOLDEN_FILE_NAME);
+        return;
+    }
+
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        Golden golden = {};
+        unsigned long long hash;
+        if (line[0] == '#' || sscanf(line, "%63s %llx", golden.name, &hash) != 2) {
+            continue;
+        }
+        ASSERT(set->count < MAX_GOLDENS);
+        golden.hash = hash;
+        set->goldens[set->count++] = golden;
+    }
+    fclose(file);
+}
+
+static Golden* findGolden(GoldenSet* set, const char* name) {
+    for (u32 i = 0; i < set->count; i++) {
+        if (strcmp(set->goldens[i].name, name) == 0) {
+            return &set->goldens[i];
+        }
+    }
+    return NULL;
+}
+
+static bool saveGoldens(GoldenSet* set) {
+    FILE* file;
+    if (fopen_s(&file, GOLDEN_FILE_NAME, "wb") != 0) {
+        LOG("Error creating %s\n", GOLDEN_FILE_NAME);
+        return false;
+    }
+    fprintf(file, "# Frame hashes checked by render_test, regenerate with render_test --update\n");
+    for (u32 i = 0; i < set->count; i++) {
+        fprintf(file, "%s %016llx\n", set->goldens[i].name, (unsigned long long)set->goldens[i].hash);
+    }
+    fclose(file);
+    return true;
+}
+
+// Writes a copy of expected with every differing pixel in magenta and the rest darkened
+static void writeDiff(const char* caseName, Bitmap* actual, Arena* scratch) {
+    char fileName[128];
+    snprintf(fileName, sizeof(fileName), "render_test_%s_actual.bmp", caseName);
+    writeBmp(fileName, actual);
+
+    snprintf(fileName, sizeof(fileName), "render_test_%s_expected.bmp", caseName);
+    FILE* probe;
+    if (fopen_s(&probe, fileName, "rb") != 0) {
+        LOG("  no %s to diff against, see --save-reference\n", fileName);
+        return;
+    }
+    fclose(probe);
+
+    usize   mark     = scratch->offset;
+    Bitmap* expected = readImageFile(scratch, scratch, fileName);
+    if (!expected || expected->width != actual->width || expected->height != actual->height) {
+        LOG("  %s does not match the frame size\n", fileName);
+        scratch->offset = mark;
+        return;
+    }
+
+    u32 differing = 0;
+    u32 minX = actual->width, minY = actual->height, maxX = 0, maxY = 0;
+    for (u32 y = 0; y < actual->height; y++) {
+        for (u32 x = 0; x < actual->width; x++) {
+            u32* e = &expected->data[y * actual->width + x];
+            if (*e != actual->data[y * actual->width + x]) {
+                *e = 0xffff00ff;
+                differing++;
+                minX = x < minX ? x : minX;
+                minY = y < minY ? y : minY;
+                maxX = x > maxX ? x : maxX;
+                maxY = y > maxY ? y : maxY;
+            } else {
+                *e = 0xff000000 | ((*e >> 2) & 0x3f3f3f);
+            }
+        }
+    }
+    LOG("  %u pixels differ within (%u, %u) - (%u, %u)\n", differing, minX, minY, maxX, maxY);
+
+    snprintf(fileName, sizeof(fileName), "render_test_%s_diff.bmp", caseName);
+    writeBmp(fileName, expected);
+    scratch->offset = mark;
+}
+
+// Both paddles chase the ball, each aiming at a different spot of itself
+static PlayerInput scriptedInput(GameState* game, u32 player) {
+    PlayerInput input = {};
+    if (!game->startedRound) {
+        input.right = true;
+        return input;
+    }
+
+    float aim = (player == 0 ? 0.4f : -0.6f) * game->players[player].halfExtents.x;
+    float dx  = game->ball.circle.center.x - (game->players[player].center.x + aim);
+    bool  left  = dx < -4.0f;
+    bool  right = dx > 4.0f;
+    if (player == 0) {
+        input.left  = left;
+        input.right = right;
+    } else {
+        input.a = left;
+        input.d = right;
+    }
+    return input;
+}
+
+struct TestRun {
+    GoldenSet* goldens;
+    bool       update;
+    bool       saveReference;
+    u32        frames;
+    u32        failures;
+    u64        hashedBytes;
+    i64        hashTicks;
+};
+
+static void checkFrame(TestRun* run, const char* caseName, Bitmap* bitmap, Arena* scratch) {
+    i64 hashStart, hashEnd;
+    QueryPerformanceCounter((LARGE_INTEGER*)&hashStart);
+    u64 hash = hashBitmap(bitmap);
+    QueryPerformanceCounter((LARGE_INTEGER*)&hashEnd);
+    run->hashTicks   += hashEnd - hashStart;
+    run->hashedBytes += sizeof(u32) * bitmap->width*bitmap->height;
+    run->frames++;
+
+    if (run->saveReference) {
+        char fileName[128];
+        snprintf(fileName, sizeof(fileName), "render_test_%s_expected.bmp", caseName);
+        writeBmp(fileName, bitmap);
+    }
+
+    Golden* golden = findGolden(run->goldens, caseName);
+    if (run->update) {
+        if (!golden) {
+            ASSERT(run->goldens->count < MAX_GOLDENS);
+            golden = &run->goldens->goldens[run->goldens->count++];
+            snprintf(golden->name, sizeof(golden->name), "%s", caseName);
+        }
+        golden->hash = hash;
+        golden->seen = true;
+        return;
+    }
+
+    if (!golden) {
+        LOG("%s: no golden hash, run with --update\n", caseName);
+        run->failures++;
+        return;
+    }
+    golden->seen = true;
+    if (golden->hash != hash) {
+        LOG("%s: hash %016llx, expected %016llx\n", caseName,
+            (unsigned long long)hash, (unsigned long long)golden->hash);
+        writeDiff(caseName, bitmap, scratch);
+        run->failures++;
+    }
+}
+
+static void runCase(TestRun* run, u32 playerCount, TestMode mode, TestSize size,
+                    Sprites* loadedSprites, Arena* arena) {
+    usize mark = arena->offset;
+
+    // every case starts from the same effect state
+    particles          = makeParticleSystem(arena, MAX_PARTICLES);
+    indexedTarget      = allocateIndexedBitmap(arena, size.width, size.height);
+    g_indexedRendering = mode == TEST_INDEXED;
+    g_antiAliasing     = mode == TEST_ANTIALIASED;
+    sprites            = mode == TEST_SPRITES ? *loadedSprites : Sprites{};
+    paletteEffects     = {};
+    Bitmap* bitmap     = allocateBitmap(arena, size.width, size.height);
+    ASSERT(particles && indexedTarget && bitmap);
+
+    GameState  game;
+    GameEvents events;
+    gameInit(&game, playerCount);
+
+    u32 captureCount = sizeof(CAPTURE_TICKS) / sizeof(CAPTURE_TICKS[0]);
+    u32 lastTick     = CAPTURE_TICKS[captureCount - 1];
+    u32 capture      = 0;
+    // particles only live for a moment, so one frame is taken shortly after the first tile breaks
+    u32 burstTick    = UINT32_MAX;
+    for (u32 tick = 0; tick <= lastTick; tick++) {
+        bool captureTick = tick == CAPTURE_TICKS[capture];
+        if (captureTick || tick == burstTick) {
+            char caseName[64];
+            snprintf(caseName, sizeof(caseName), "%s_%s_%ux%u_t%04u", playerCount > 1 ? "versus" : "single",
+                     TEST_MODE_NAMES[mode], size.width, size.height, tick);
+            render(&game, bitmap);
+            checkFrame(run, caseName, bitmap, arena);
+            capture += captureTick ? 1 : 0;
+        }
+
+        PlayerInput inputs[MAX_PLAYERS] = {};
+        for (u32 player = 0; player < playerCount; player++) {
+            inputs[player] = scriptedInput(&game, player);
+        }
+        events.count = 0;
+        gameUpdate(&game, inputs, GAME_TICK_SECONDS, &events);
+        updateEffects(&events, GAME_TICK_SECONDS);
+        for (u32 i = 0; i < events.count && burstTick == UINT32_MAX; i++) {
+            if (events.events[i].type == GAME_EVENT_TILE_DESTROYED) {
+                burstTick = tick + 12;
+            }
+        }
+    }
+
+    arena->offset = mark;
+}
+
+enum BenchShape {
+    BENCH_TILE,
+    BENCH_PADDLE,
+    BENCH_BALL,
+    BENCH_SHAPE_COUNT,
+};
+
+static const char* BENCH_SHAPE_NAMES[BENCH_SHAPE_COUNT] = {"tile", "paddle", "ball"};
+
+static void drawBenchShapes(BenchShape shape, bool antiAliased, Vec2* centers, u32 count,
+                            GameState* game, Bitmap* bitmap) {
+    Vec2  tileHalfSize   = vec2(game->tiles.halfExtentX[0], game->tiles.halfExtentY[0]);
+    Vec2  paddleHalfSize = game->players[0].halfExtents;
+    float radius         = game->ball.circle.radius;
+    for (u32 i = 0; i < count; i++) {
+        if (shape == BENCH_BALL) {
+            if (antiAliased) {
+                drawCircleAA(0xff00ff00, centers[i], radius, bitmap);
+            } else {
+                drawCircle(0xff00ff00, centers[i], radius, bitmap);
+            }
+        } else {
+            Vec2 halfSize = shape == BENCH_TILE ? tileHalfSize : paddleHalfSize;
+            if (antiAliased) {
+                drawSquareAA(0xffff0000, centers[i], halfSize, bitmap);
+            } else {
+                drawSquare(0xffff0000, centers[i], halfSize, bitmap);
+            }
+        }
+    }
+}
+
+// Draws every shape of the game at the same sub-pixel positions with both
+// rasterizers and reports the best of several rounds
+static void runBenchmark(Arena* arena) {
+    constexpr u32 SHAPE_COUNT = 4096;
+    constexpr u32 ROUNDS      = 16;
+
+    Bitmap* bitmap  = allocateBitmap(arena, WIDTH, HEIGHT);
+    Vec2*   centers = pushCount(arena, Vec2, SHAPE_COUNT);
+    ASSERT(bitmap && centers);
+    memset(bitmap->data, 0, sizeof(u32) * bitmap->width*bitmap->height);
+
+    u32 random = 1234;
+    for (u32 i = 0; i < SHAPE_COUNT; i++) {
+        centers[i] = vec2(60 + (WIDTH - 120) * randomUnilateral(&random),
+                          60 + (HEIGHT - 120) * randomUnilateral(&random));
+    }
+
+    GameState game;
+    gameInit(&game);
+
+    i64 frequency;
+    QueryPerformanceFrequency((LARGE_INTEGER*)&frequency);
+    printf("%-8s %14s %14s %7s\n", "shape", "aliased us", "aa us", "ratio");
+    for (u32 shape = 0; shape < BENCH_SHAPE_COUNT; shape++) {
+        double best[2] = {1e30, 1e30};
+        for (u32 round = 0; round < ROUNDS; round++) {
+            for (u32 antiAliased = 0; antiAliased < 2; antiAliased++) {
+                i64 start, end;
+                QueryPerformanceCounter((LARGE_INTEGER*)&start);
+                drawBenchShapes((BenchShape)shape, antiAliased != 0, centers, SHAPE_COUNT, &game, bitmap);
+                QueryPerformanceCounter((LARGE_INTEGER*)&end);
+                double microseconds = (double)(end - start) * 1e6 / frequency / SHAPE_COUNT;
+                best[antiAliased] = microseconds < best[antiAliased] ? microseconds : best[antiAliased];
+            }
+        }
+        printf("%-8s %14.3f %14.3f %6.2fx\n", BENCH_SHAPE_NAMES[shape], best[0], best[1], best[1] / best[0]);
+    }
+}
+
+int main(int argc, char** argv) {
+    TestRun run = {};
+    bool benchmark = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--update") == 0) {
+            run.update = true;
+        } else if (strcmp(argv[i], "--save-reference") == 0) {
+            run.saveReference = true;
+        } else if (strcmp(argv[i], "--bench") == 0) {
+            benchmark = true;
+        } else {
+            LOG("usage: %s [--update] [--save-reference] [--bench]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    Arena arena = {};
+    arena.capacity = (usize)MB(128);
+    arena.memory   = (u8*)malloc(arena.capacity);
+    ASSERT(arena.memory != NULL);
+
+    if (benchmark) {
+        runBenchmark(&arena);
+        free(arena.memory);
+        return 0;
+    }
+
+    font      = makeFont(&arena, 2);
+    textBatch = makeTextBatch(&arena, 4096);
+    ASSERT(font != NULL && textBatch != NULL);
+
+    Sprites loadedSprites = {};
+    loadedSprites.tile   = readImageFile(&arena, &arena, "data/images/tile.bmp");
+    loadedSprites.paddle = readImageFile(&arena, &arena, "data/images/paddle.bmp");
+    loadedSprites.ball   = readImageFile(&arena, &arena, "data/images/ball.bmp");
+    if (!loadedSprites.tile || !loadedSprites.paddle || !loadedSprites.ball) {
+        LOG("Missing sprites, render_test has to run from the repository root\n");
+        return 1;
+    }
+
+    // updating starts from an empty set, so hashes of removed cases go away
+    static GoldenSet goldens;
+    if (!run.update) {
+        loadGoldens(&goldens);
+    }
+    run.goldens = &goldens;
+
+    i64 frequency, startTimeStamp, endTimeStamp;
+    QueryPerformanceFrequency((LARGE_INTEGER*)&frequency);
+    QueryPerformanceCounter((LARGE_INTEGER*)&startTimeStamp);
+
+    for (u32 playerCount = 1; playerCount <= MAX_PLAYERS; playerCount++) {
+        for (u32 mode = 0; mode < TEST_MODE_COUNT; mode++) {
+            for (u32 size = 0; size < sizeof(TEST_SIZES) / sizeof(TEST_SIZES[0]); size++) {
+                runCase(&run, playerCount, (TestMode)mode, TEST_SIZES[size], &loadedSprites, &arena);
+            }
+        }
+    }
+
+    QueryPerformanceCounter((LARGE_INTEGER*)&endTimeStamp);
+    double seconds     = (double)(endTimeStamp - startTimeStamp) / frequency;
+    double hashSeconds = (double)run.hashTicks / frequency;
+
+    if (run.update) {
+        if (!saveGoldens(&goldens)) {
+            return 1;
+        }
+        printf("wrote %u golden hashes to %s\n", run.frames, GOLDEN_FILE_NAME);
+    } else {
+        for (u32 i = 0; i < goldens.count; i++) {
+            if (!goldens.goldens[i].seen) {
+                LOG("%s: golden hash without a matching frame\n", goldens.goldens[i].name);
+                run.failures++;
+            }
+        }
+        printf("%u frames, %u failed\n", run.frames, run.failures);
+    }
+    printf("wall time   %.3f s\n", seconds);
+    printf("hashing     %.1f MB in %.2f ms, %.1f GB/s\n", run.hashedBytes / (1024.0*1024.0),
+           hashSeconds * 1000.0, hashSeconds > 0 ? run.hashedBytes / hashSeconds / 1e9 : 0.0);
+
+    free(arena.memory);
+    return run.failures ? 1 : 0;
+}
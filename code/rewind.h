@@ -0,0 +1,239 @@
+#ifndef BREAKOUT_REWIND_H_
+#define BREAKOUT_REWIND_H_
+
+#include "game.h"
+
+// Keeps a GameState snapshot for every tick in a ring of bytes. Every
+// REWIND_KEYFRAME_INTERVAL ticks a keyframe is stored, all other ticks are
+// stored as the XOR against the latest keyframe. Both are run length encoded
+// as (u16 zero run, u16 literal count, literal bytes) tokens, keyframes
+// against an all zero state so unused tile slots cost nothing.
+//
+// Restoring a tick decodes at most one keyframe and one delta.
+
+#define REWIND_KEYFRAME_INTERVAL 64
+
+static_assert(sizeof(GameState) < 0xffff, "rewind tokens store byte counts in u16");
+
+// worst case is alternating single literal and zero bytes
+static constexpr u32 REWIND_MAX_ENCODED_SIZE = 3 * sizeof(GameState) + 4;
+
+struct RewindFrame {
+    u64  tick;
+    u32  offset;
+    u32  size;
+    bool keyframe;
+};
+
+struct RewindBuffer {
+    RewindFrame* frames;
+    u32          frameCapacity;
+    u32          firstFrame;
+    u32          frameCount;
+
+    u8*          data;
+    u32          dataCapacity;
+    u32          dataHead;
+
+    GameState    keyframeState;
+    u64          keyframeTick;
+};
+
+static RewindBuffer* makeRewindBuffer(Arena* arena, u32 tickCapacity, u32 dataCapacity) {
+    ASSERT(dataCapacity >= 2 * REWIND_MAX_ENCODED_SIZE);
+    RewindBuffer* rewind = push(arena, RewindBuffer);
+    if (!rewind) {
+        return NULL;
+    }
+    *rewind = {};
+    rewind->frames = pushCount(arena, RewindFrame, tickCapacity);
+    rewind->data   = (u8*)allocate(arena, dataCapacity, 16);
+    if (!rewind->frames || !rewind->data) {
+        return NULL;
+    }
+    rewind->frameCapacity = tickCapacity;
+    rewind->dataCapacity  = dataCapacity;
+    return rewind;
+}
+
+// base may be NULL for an all zero base
+static u32 rewindEncode(u8* out, u8* state, u8* base, u32 size) {
+    u8* start = out;
+    u32 i = 0;
+    while (i < size) {
+        u32 zeroRun = 0;
+        while (i < size && (u8)(state[i] ^ (base ? base[i] : 0)) == 0) {
+            zeroRun++;
+            i++;
+        }
+        u32 literalStart = i;
+        // a literal run ends at the first pair of zeros, a single zero is cheaper inline
+        while (i < size) {
+            bool zero     = (u8)(state[i] ^ (base ? base[i] : 0)) == 0;
+            bool nextZero = i + 1 >= size || (u8)(state[i + 1] ^ (base ? base[i + 1] : 0)) == 0;
+            if (zero && nextZero) {
+                break;
+            }
+            i++;
+        }
+        u16 literalCount = (u16)(i - literalStart);
+        if (literalCount == 0 && i == size) {
+            break;
+        }
+
+        u16 run = (u16)zeroRun;
+        memcpy(out, &run, 2);
+        memcpy(out + 2, &literalCount, 2);
+        out += 4;
+        for (u32 j = literalStart; j < i; j++) {
+            *out++ = state[j] ^ (base ? base[j] : 0);
+        }
+    }
+    return (u32)(out - start);
+}
+
+// XORs the decoded bytes into state, which has to hold the base already
+static void rewindDecode(u8* state, u8* in, u32 encodedSize) {
+    u8* end = in + encodedSize;
+    u32 i = 0;
+    while (in < end) {
+        u16 zeroRun, literalCount;
+        memcpy(&zeroRun, in, 2);
+        memcpy(&literalCount, in + 2, 2);
+        in += 4;
+        i  += zeroRun;
+        for (u32 j = 0; j < literalCount; j++) {
+            state[i++] ^= *in++;
+        }
+    }
+}
+
+static RewindFrame* rewindFrame(RewindBuffer* rewind, u32 index) {
+    return &rewind->frames[(rewind->firstFrame + index) % rewind->frameCapacity];
+}
+
+// Drops the oldest frame, along with the deltas that depended on it when it was a keyframe
+static void rewindEvictOldest(RewindBuffer* rewind) {
+    do {
+        rewind->firstFrame = (rewind->firstFrame + 1) % rewind->frameCapacity;
+        rewind->frameCount--;
+    } while (rewind->frameCount > 0 && !rewindFrame(rewind, 0)->keyframe);
+}
+
+// Makes room for size contiguous bytes at dataHead
+static void rewindReserve(RewindBuffer* rewind, u32 size) {
+    for (;;) {
+        if (rewind->frameCount == 0) {
+            rewind->dataHead = 0;
+            return;
+        }
+
+        u32 tail = rewindFrame(rewind, 0)->offset;
+        if (tail >= rewind->dataHead) {
+            if (tail - rewind->dataHead >= size) {
+                return;
+            }
+        } else if (rewind->dataCapacity - rewind->dataHead >= size) {
+            return;
+        } else if (tail >= size) {
+            rewind->dataHead = 0;
+            return;
+        }
+        rewindEvictOldest(rewind);
+    }
+}
+
+static void rewindRecord(RewindBuffer* rewind, GameState* state) {
+    if (rewind->frameCount == rewind->frameCapacity) {
+        rewindEvictOldest(rewind);
+    }
+
+    // reserving may evict the current keyframe, so decide afterwards
+    rewindReserve(rewind, REWIND_MAX_ENCODED_SIZE);
+    bool keyframe = rewind->frameCount == 0 ||
+                    state->tick - rewind->keyframeTick >= REWIND_KEYFRAME_INTERVAL;
+
+    u8* out  = rewind->data + rewind->dataHead;
+    u32 size = rewindEncode(out, (u8*)state, keyframe ? NULL : (u8*)&rewind->keyframeState,
+                            sizeof(GameState));
+    if (keyframe) {
+        rewind->keyframeState = *state;
+        rewind->keyframeTick  = state->tick;
+    }
+
+    RewindFrame* frame = rewindFrame(rewind, rewind->frameCount++);
+    frame->tick     = state->tick;
+    frame->offset   = rewind->dataHead;
+    frame->size     = size;
+    frame->keyframe = keyframe;
+    rewind->dataHead += size;
+}
+
+static u64 rewindOldestTick(RewindBuffer* rewind) {
+    return rewind->frameCount ? rewindFrame(rewind, 0)->tick : 0;
+}
+
+static u64 rewindNewestTick(RewindBuffer* rewind) {
+    return rewind->frameCount ? rewindFrame(rewind, rewind->frameCount - 1)->tick : 0;
+}
+
+static u32 rewindBytesUsed(RewindBuffer* rewind) {
+    if (rewind->frameCount == 0) {
+        return 0;
+    }
+    u32 tail = rewindFrame(rewind, 0)->offset;
+    return rewind->dataHead > tail ? rewind->dataHead - tail
+                                   : rewind->dataCapacity - tail + rewind->dataHead;
+}
+
+// Decodes the state at tick, returns false when it is not in the buffer
+static bool rewindRestore(RewindBuffer* rewind, u64 tick, GameState* state) {
+    if (rewind->frameCount == 0 || tick < rewindOldestTick(rewind) || tick > rewindNewestTick(rewind)) {
+        return false;
+    }
+
+    // ticks are recorded back to back, so the frame index follows from the tick
+    u32 index = (u32)(tick - rewindOldestTick(rewind));
+    RewindFrame* frame = rewindFrame(rewind, index);
+    ASSERT(frame->tick == tick);
+
+    u32 keyIndex = index;
+    while (!rewindFrame(rewind, keyIndex)->keyframe) {
+        keyIndex--;
+    }
+    RewindFrame* key = rewindFrame(rewind, keyIndex);
+
+    memset(state, 0, sizeof(GameState));
+    rewindDecode((u8*)state, rewind->data + key->offset, key->size);
+    if (frame != key) {
+        rewindDecode((u8*)state, rewind->data + frame->offset, frame->size);
+    }
+    return true;
+}
+
+// Forgets every tick after tick, so recording continues from there
+static void rewindTruncate(RewindBuffer* rewind, u64 tick) {
+    if (rewind->frameCount == 0 || tick < rewindOldestTick(rewind)) {
+        rewind->frameCount = 0;
+        rewind->dataHead   = 0;
+        return;
+    }
+    if (tick >= rewindNewestTick(rewind)) {
+        return;
+    }
+
+    rewind->frameCount = (u32)(tick - rewindOldestTick(rewind)) + 1;
+    RewindFrame* last = rewindFrame(rewind, rewind->frameCount - 1);
+    rewind->dataHead = last->offset + last->size;
+
+    u32 keyIndex = rewind->frameCount - 1;
+    while (!rewindFrame(rewind, keyIndex)->keyframe) {
+        keyIndex--;
+    }
+    RewindFrame* key = rewindFrame(rewind, keyIndex);
+    memset(&rewind->keyframeState, 0, sizeof(GameState));
+    rewindDecode((u8*)&rewind->keyframeState, rewind->data + key->offset, key->size);
+    rewind->keyframeTick = key->tick;
+}
+
+#endif // BREAKOUT_REWIND_H_
@@ -0,0 +1,145 @@
+// Determinism test for the rewind buffer: plays a scripted game headless,
+// keeps a plain copy of every recorded state next to the rewind buffer and
+// rewinds to random ticks along the way, the way holding R does in the game.
+// Every restored state has to match its copy byte for byte.
+//
+// usage: rewind_test [ticks]
+//
+// ticks counts the ticks played, rewinding does not count towards it.
+//
+// Runs once with room for every tick of the window and once with a data
+// ring so small that byte pressure evicts frames before the tick limit does.
+
+#include "game.h"
+#include "rewind.h"
+
+static constexpr u32 REWIND_TEST_WINDOW = 2401; // 10 s, like the game
+
+struct RewindTest {
+    RewindBuffer* rewind;
+    GameState*    history;  // indexed by tick % REWIND_TEST_WINDOW
+    u32           random;
+    u64           restores;
+    u64           rewoundTicks;
+    u32           mismatches;
+};
+
+// Follows the ball with the occasional random press, so tiles break and
+// balls are lost every now and then
+static PlayerInput testInput(GameState* game, u32* random) {
+    PlayerInput input = {};
+    if (!game->startedRound) {
+        input.right = true;
+        return input;
+    }
+
+    if (randomU32(random) % 8 == 0) {
+        input.left  = randomU32(random) % 2 == 0;
+        input.right = randomU32(random) % 2 == 0;
+        return input;
+    }
+    float dx = game->ball.circle.center.x - game->players[0].center.x;
+    input.left  = dx < -4.0f;
+    input.right = dx > 4.0f;
+    return input;
+}
+
+static void recordTick(RewindTest* test, GameState* game) {
+    rewindRecord(test->rewind, game);
+    memcpy(&test->history[game->tick % REWIND_TEST_WINDOW], game, sizeof(GameState));
+}
+
+static void checkRestore(RewindTest* test, u64 tick, GameState* state) {
+    test->restores++;
+    if (!rewindRestore(test->rewind, tick, state)) {
+        LOG("tick %llu: not in the rewind buffer, oldest is %llu\n", (unsigned long long)tick,
+            (unsigned long long)rewindOldestTick(test->rewind));
+        test->mismatches++;
+        return;
+    }
+    if (memcmp(state, &test->history[tick % REWIND_TEST_WINDOW], sizeof(GameState)) != 0) {
+        LOG("tick %llu: restored state differs from the recorded one\n", (unsigned long long)tick);
+        test->mismatches++;
+    }
+}
+
+static void runRewindTest(RewindTest* test, u64 tickCount) {
+    GameState game;
+    gameInit(&game);
+    recordTick(test, &game);
+
+    for (u64 step = 0; step < tickCount; step++) {
+        RewindBuffer* rewind = test->rewind;
+        if (rewindNewestTick(rewind) - rewindOldestTick(rewind) + 1 > REWIND_TEST_WINDOW) {
+            LOG("rewind buffer holds more ticks than it was made for\n");
+            test->mismatches++;
+            return;
+        }
+
+        u32 roll = randomU32(&test->random) % 4000;
+        if (roll < 1) {
+            // hold R: step back one tick at a time, then play on from there
+            u32 steps = 1 + randomU32(&test->random) % REWIND_TEST_WINDOW;
+            for (u32 i = 0; i < steps && game.tick > rewindOldestTick(rewind); i++) {
+                u64 tick = game.tick - 1;
+                checkRestore(test, tick, &game);
+                test->rewoundTicks++;
+                // a failed restore leaves nothing to compare against
+                if (game.tick != tick) {
+                    return;
+                }
+            }
+            rewindTruncate(rewind, game.tick);
+        } else if (roll < 9) {
+            // jump anywhere into the window without disturbing the game
+            u64 oldest = rewindOldestTick(rewind);
+            u64 tick   = oldest + randomU32(&test->random) % (rewindNewestTick(rewind) - oldest + 1);
+            GameState restored;
+            checkRestore(test, tick, &restored);
+        }
+
+        PlayerInput input = testInput(&game, &test->random);
+        gameUpdate(&game, &input, GAME_TICK_SECONDS, NULL);
+        recordTick(test, &game);
+    }
+}
+
+int main(int argc, char** argv) {
+    u64 tickCount = 200000;
+    if (argc > 1) {
+        tickCount = strtoull(argv[1], NULL, 10);
+    }
+
+    Arena arena = {};
+    arena.capacity = (usize)MB(64);
+    arena.memory   = (u8*)malloc(arena.capacity);
+    ASSERT(arena.memory != NULL);
+
+    struct {
+        const char* name;
+        u32         dataCapacity;
+    } configs[] = {
+        {"roomy", (u32)KB(512)},
+        {"tight", 4 * REWIND_MAX_ENCODED_SIZE},
+    };
+
+    u32 mismatches = 0;
+    for (u32 i = 0; i < sizeof(configs) / sizeof(configs[0]); i++) {
+        usize mark = arena.offset;
+        RewindTest test = {};
+        test.rewind  = makeRewindBuffer(&arena, REWIND_TEST_WINDOW, configs[i].dataCapacity);
+        test.history = pushCount(&arena, GameState, REWIND_TEST_WINDOW);
+        test.random  = 0x9e3779b9u + i;
+        ASSERT(test.rewind && test.history);
+
+        runRewindTest(&test, tickCount);
+        printf("%-6s %llu ticks played, %llu restores, %llu ticks rewound, %u mismatches\n", configs[i].name,
+               (unsigned long long)tickCount, (unsigned long long)test.restores,
+               (unsigned long long)test.rewoundTicks, test.mismatches);
+        mismatches += test.mismatches;
+        arena.offset = mark;
+    }
+
+    free(arena.memory);
+    return mismatches ? 1 : 0;
+}
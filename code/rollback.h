@@ -0,0 +1,180 @@
+#ifndef BREAKOUT_ROLLBACK_H_
+#define BREAKOUT_ROLLBACK_H_
+
+#include "game.h"
+#include "transport.h"
+
+// Two player rollback session. Local input is applied on the tick it is
+// sampled, the remote player's input is predicted to stay what it was last
+// seen as. When the real remote input for an already simulated tick turns
+// out different, the session restores the state saved before that tick and
+// re-simulates up to the present.
+//
+// Every packet carries all local inputs the peer has not acknowledged yet,
+// so lost or reordered packets only delay inputs instead of losing them.
+// The session never runs more than ROLLBACK_WINDOW - 1 ticks ahead of what
+// it knows about the other peer, it stalls instead.
+//
+// Everything lives inside RollbackSession, re-simulating allocates nothing.
+
+#define ROLLBACK_WINDOW 32
+
+struct RollbackPacket {
+    u64         firstTick;  // tick of inputs[0]
+    u64         ackTick;    // sender has every input before this tick
+    u32         inputCount;
+    PlayerInput inputs[ROLLBACK_WINDOW];
+};
+
+struct RollbackStats {
+    u64   rollbacks;
+    u64   resimulatedTicks;
+    u32   lastRollbackTicks;
+    u32   maxRollbackTicks;
+    u64   stalls;
+};
+
+struct RollbackSession {
+    Transport*    transport;
+    u32           localPlayer;
+    u32           remotePlayer;
+
+    GameState     state;
+    // indexed by tick % ROLLBACK_WINDOW, states[t] is the state before tick t was simulated
+    GameState     states[ROLLBACK_WINDOW];
+    PlayerInput   inputs[ROLLBACK_WINDOW][MAX_PLAYERS];
+
+    u64           remoteConfirmedTick; // remote inputs are known for every tick before this
+    u64           localAckedTick;      // the peer has every local input before this
+    u64           mispredictedTick;    // oldest simulated tick with a wrong prediction
+    PlayerInput   lastRemoteInput;
+
+    RollbackStats stats;
+};
+
+static RollbackSession* makeRollbackSession(Arena* arena, Transport* transport, u32 localPlayer) {
+    ASSERT(localPlayer < 2);
+    RollbackSession* session = push(arena, RollbackSession);
+    if (!session) {
+        return NULL;
+    }
+    *session = {};
+    session->transport        = transport;
+    session->localPlayer      = localPlayer;
+    session->remotePlayer     = 1 - localPlayer;
+    session->mispredictedTick = UINT64_MAX;
+    gameInit(&session->state, 2);
+    return session;
+}
+
+static bool samePlayerInput(PlayerInput* a, PlayerInput* b) {
+    return a->left == b->left && a->right == b->right && a->a == b->a && a->d == b->d;
+}
+
+static void rollbackSendInputs(RollbackSession* session) {
+    RollbackPacket packet;
+    packet.firstTick  = session->localAckedTick;
+    packet.ackTick    = session->remoteConfirmedTick;
+    packet.inputCount = (u32)(session->state.tick - session->localAckedTick);
+    ASSERT(packet.inputCount <= ROLLBACK_WINDOW);
+    for (u32 i = 0; i < packet.inputCount; i++) {
+        u64 tick = packet.firstTick + i;
+        packet.inputs[i] = session->inputs[tick % ROLLBACK_WINDOW][session->localPlayer];
+    }
+
+    u32 size = (u32)(offsetof(RollbackPacket, inputs) + packet.inputCount * sizeof(PlayerInput));
+    session->transport->send(session->transport->user, &packet, size);
+}
+
+static void rollbackReceiveInputs(RollbackSession* session) {
+    RollbackPacket packet;
+    u32 size;
+    while ((size = session->transport->receive(session->transport->user, &packet, sizeof(packet))) != 0) {
+        if (size < offsetof(RollbackPacket, inputs) || packet.inputCount > ROLLBACK_WINDOW ||
+            size != offsetof(RollbackPacket, inputs) + packet.inputCount * sizeof(PlayerInput)) {
+            LOG("Dropping malformed rollback packet\n");
+            continue;
+        }
+
+        if (packet.ackTick > session->localAckedTick) {
+            session->localAckedTick = min((i64)packet.ackTick, (i64)session->state.tick);
+        }
+
+        for (u32 i = 0; i < packet.inputCount; i++) {
+            u64 tick = packet.firstTick + i;
+            if (tick < session->remoteConfirmedTick) {
+                continue;
+            }
+            // only the unacknowledged tail is sent, so a gap means a bogus packet
+            if (tick != session->remoteConfirmedTick) {
+                break;
+            }
+
+            PlayerInput* slot = &session->inputs[tick % ROLLBACK_WINDOW][session->remotePlayer];
+            if (tick < session->state.tick && tick < session->mispredictedTick &&
+                !samePlayerInput(slot, &packet.inputs[i])) {
+                session->mispredictedTick = tick;
+            }
+            *slot = packet.inputs[i];
+            session->lastRemoteInput     = packet.inputs[i];
+            session->remoteConfirmedTick = tick + 1;
+        }
+    }
+}
+
+static void rollbackResimulate(RollbackSession* session) {
+    u64 from = session->mispredictedTick;
+    u64 to   = session->state.tick;
+    session->mispredictedTick = UINT64_MAX;
+
+    session->state = session->states[from % ROLLBACK_WINDOW];
+    ASSERT(session->state.tick == from);
+    for (u64 tick = from; tick < to; tick++) {
+        PlayerInput* inputs = session->inputs[tick % ROLLBACK_WINDOW];
+        if (tick >= session->remoteConfirmedTick) {
+            inputs[session->remotePlayer] = session->lastRemoteInput;
+        }
+        if (tick > from) {
+            session->states[tick % ROLLBACK_WINDOW] = session->state;
+        }
+        // effects for these ticks were already played from the prediction
+        gameUpdate(&session->state, inputs, GAME_TICK_SECONDS, NULL);
+    }
+
+    u32 ticks = (u32)(to - from);
+    session->stats.rollbacks++;
+    session->stats.resimulatedTicks += ticks;
+    session->stats.lastRollbackTicks = ticks;
+    session->stats.maxRollbackTicks  = ticks > session->stats.maxRollbackTicks ? ticks : session->stats.maxRollbackTicks;
+}
+
+// Runs one tick with the given local input. Returns false when the session
+// had to stall because the peer is too far behind, state is unchanged then.
+static bool rollbackAdvance(RollbackSession* session, PlayerInput localInput, GameEvents* events) {
+    rollbackReceiveInputs(session);
+
+    if (session->mispredictedTick < session->state.tick) {
+        rollbackResimulate(session);
+    }
+
+    u64 tick   = session->state.tick;
+    u64 oldest = min((i64)session->remoteConfirmedTick, (i64)session->localAckedTick);
+    if (tick + 1 - oldest >= ROLLBACK_WINDOW) {
+        session->stats.stalls++;
+        rollbackSendInputs(session);
+        return false;
+    }
+
+    PlayerInput* inputs = session->inputs[tick % ROLLBACK_WINDOW];
+    inputs[session->localPlayer] = localInput;
+    if (tick >= session->remoteConfirmedTick) {
+        inputs[session->remotePlayer] = session->lastRemoteInput;
+    }
+    session->states[tick % ROLLBACK_WINDOW] = session->state;
+    gameUpdate(&session->state, inputs, GAME_TICK_SECONDS, events);
+
+    rollbackSendInputs(session);
+    return true;
+}
+
+#endif // BREAKOUT_ROLLBACK_H_
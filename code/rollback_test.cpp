@@ -0,0 +1,197 @@
+// Determinism test for rollback: runs both peers of a versus session in
+// one process over lossy, jittery loopback links, each driven by a scripted
+// player that only sees its own, partly predicted, state. A lockstep game
+// fed the inputs both peers actually committed serves as the reference.
+//
+// usage: rollback_test [ticks]
+//
+// After every tick, the newest state a peer has all inputs for has to match
+// the reference. At the end both peers settle on the last tick and have to
+// be byte identical to each other and to the reference.
+
+#include "game.h"
+#include "rollback.h"
+
+static constexpr u32 REFERENCE_HISTORY = 4 * ROLLBACK_WINDOW;
+// stalls stretch a run, the harsh link needs under two steps per tick
+static constexpr u32 MAX_STEPS_PER_TICK = 4;
+
+struct LinkConditions {
+    const char* name;
+    float       latencySeconds;
+    float       jitterSeconds;
+    float       lossRate;
+};
+
+static const LinkConditions TEST_LINKS[] = {
+    {"default", 0.04f, 0.01f, 0.05f},
+    {"harsh",   0.08f, 0.06f, 0.30f},
+};
+
+struct RollbackTest {
+    LoopbackLink     links[2];
+    LoopbackEndpoint endpoints[2];
+    Transport        transports[2];
+    RollbackSession* sessions[2];
+    u32              random[2];
+
+    PlayerInput*     inputs;       // [tick][player], what each peer committed
+    u64              tickCount;
+
+    GameState        reference;
+    GameState        history[REFERENCE_HISTORY]; // indexed by tick % REFERENCE_HISTORY
+
+    u64              checks;
+    u32              mismatches;
+};
+
+// Follows the ball with the occasional random press, so both paddles move
+// and the remote input keeps changing under the prediction
+static PlayerInput testInput(GameState* game, u32 player, u32* random) {
+    PlayerInput input = {};
+    if (randomU32(random) % 8 == 0) {
+        input.left  = randomU32(random) % 2 == 0;
+        input.right = randomU32(random) % 2 == 0;
+        return input;
+    }
+    float dx = game->ball.circle.center.x - game->players[player].center.x;
+    input.left  = dx < -4.0f;
+    input.right = dx > 4.0f;
+    return input;
+}
+
+static GameState* referenceAt(RollbackTest* test, u64 tick) {
+    ASSERT(tick + REFERENCE_HISTORY > test->reference.tick);
+    while (test->reference.tick < tick) {
+        gameUpdate(&test->reference, &test->inputs[test->reference.tick * 2], GAME_TICK_SECONDS, NULL);
+        test->history[test->reference.tick % REFERENCE_HISTORY] = test->reference;
+    }
+    return &test->history[tick % REFERENCE_HISTORY];
+}
+
+// States up to remoteConfirmedTick only depend on inputs both peers agree on
+static void checkConfirmedState(RollbackTest* test, RollbackSession* session) {
+    u64 tick = min((i64)session->remoteConfirmedTick, (i64)session->state.tick);
+    if (tick + ROLLBACK_WINDOW <= session->state.tick) {
+        return;
+    }
+    GameState* state = tick == session->state.tick ? &session->state : &session->states[tick % ROLLBACK_WINDOW];
+
+    test->checks++;
+    if (memcmp(state, referenceAt(test, tick), sizeof(GameState)) != 0) {
+        LOG("peer %u, tick %llu: confirmed state differs from the reference\n", session->localPlayer,
+            (unsigned long long)tick);
+        test->mismatches++;
+    }
+}
+
+static void stepPeer(RollbackTest* test, u32 peer) {
+    RollbackSession* session = test->sessions[peer];
+    u64 tick = session->state.tick;
+    if (tick < test->tickCount) {
+        PlayerInput input = testInput(&session->state, peer, &test->random[peer]);
+        if (rollbackAdvance(session, input, NULL)) {
+            test->inputs[tick * 2 + peer] = input;
+        }
+    } else {
+        // done, only take in the remaining remote inputs and keep acknowledging
+        rollbackReceiveInputs(session);
+        if (session->mispredictedTick < session->state.tick) {
+            rollbackResimulate(session);
+        }
+        rollbackSendInputs(session);
+    }
+    checkConfirmedState(test, session);
+}
+
+static bool settled(RollbackTest* test) {
+    for (u32 i = 0; i < 2; i++) {
+        RollbackSession* session = test->sessions[i];
+        if (session->state.tick < test->tickCount || session->remoteConfirmedTick < test->tickCount ||
+            session->mispredictedTick < session->state.tick) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void runRollbackTest(RollbackTest* test) {
+    gameInit(&test->reference, 2);
+    test->history[0] = test->reference;
+
+    u64 step = 0;
+    u64 maxSteps = MAX_STEPS_PER_TICK * test->tickCount + 1000;
+    for (; step < maxSteps && !settled(test); step++) {
+        for (u32 i = 0; i < 2; i++) {
+            advanceLoopbackLink(&test->links[i], GAME_TICK_SECONDS);
+        }
+        for (u32 i = 0; i < 2; i++) {
+            stepPeer(test, i);
+        }
+    }
+    if (step == maxSteps) {
+        LOG("peers did not settle on tick %llu\n", (unsigned long long)test->tickCount);
+        test->mismatches++;
+        return;
+    }
+
+    GameState* reference = referenceAt(test, test->tickCount);
+    for (u32 i = 0; i < 2; i++) {
+        if (memcmp(&test->sessions[i]->state, reference, sizeof(GameState)) != 0) {
+            LOG("peer %u: final state differs from the reference\n", i);
+            test->mismatches++;
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    u64 tickCount = 100000;
+    if (argc > 1) {
+        tickCount = strtoull(argv[1], NULL, 10);
+    }
+
+    Arena arena = {};
+    arena.capacity = (usize)MB(64);
+    arena.memory   = (u8*)malloc(arena.capacity);
+    ASSERT(arena.memory != NULL);
+
+    u32 mismatches = 0;
+    for (u32 c = 0; c < sizeof(TEST_LINKS) / sizeof(TEST_LINKS[0]); c++) {
+        const LinkConditions* conditions = &TEST_LINKS[c];
+        usize mark = arena.offset;
+
+        RollbackTest* test = push(&arena, RollbackTest);
+        ASSERT(test != NULL);
+        *test = {};
+        test->tickCount = tickCount;
+        test->inputs    = pushCount(&arena, PlayerInput, 2 * tickCount);
+        ASSERT(test->inputs != NULL);
+        memset(test->inputs, 0, 2 * tickCount * sizeof(PlayerInput));
+
+        for (u32 i = 0; i < 2; i++) {
+            initLoopbackLink(&test->links[i], conditions->latencySeconds, conditions->jitterSeconds,
+                             conditions->lossRate, i + 1);
+        }
+        for (u32 i = 0; i < 2; i++) {
+            test->endpoints[i]  = {.outgoing = &test->links[i], .incoming = &test->links[1 - i]};
+            test->transports[i] = makeLoopbackTransport(&test->endpoints[i]);
+            test->sessions[i]   = makeRollbackSession(&arena, &test->transports[i], i);
+            test->random[i]     = 0x9e3779b9u * (i + 1) + c;
+            ASSERT(test->sessions[i] != NULL);
+        }
+
+        runRollbackTest(test);
+
+        RollbackStats* stats = &test->sessions[0]->stats;
+        printf("%-8s %llu ticks, %llu rollbacks, %llu resimulated ticks, max %u, %llu stalls, "
+               "%llu checks, %u mismatches\n",
+               conditions->name, (unsigned long long)tickCount, (unsigned long long)stats->rollbacks,
+               (unsigned long long)stats->resimulatedTicks, stats->maxRollbackTicks,
+               (unsigned long long)stats->stalls, (unsigned long long)test->checks, test->mismatches);
+        mismatches += test->mismatches;
+        arena.offset = mark;
+    }
+
+    free(arena.memory);
+    return mismatches ? 1 : 0;
+}
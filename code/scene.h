@@ -0,0 +1,204 @@
+#ifndef BREAKOUT_SCENE_H_
+#define BREAKOUT_SCENE_H_
+
+#include "render.h"
+#include "text.h"
+#include "particles.h"
+#include "game.h"
+
+// Draws a GameState into a Bitmap. Everything here only depends on the
+// globals below, which the platform layer fills in, so headless tools can
+// render the same frames the game does.
+
+// Optional images, shapes fall back to flat colors when one is missing
+struct Sprites {
+    Bitmap* tile;
+    Bitmap* paddle;
+    Bitmap* ball;
+};
+static Sprites sprites;
+
+static Font*      font;
+static TextBatch* textBatch;
+
+#define MAX_PARTICLES (128 * 1024)
+static ParticleSystem* particles;
+
+// Optional 8-bit target, used instead of drawing straight into the 32-bit
+// back buffer while g_indexedRendering is on, for the palette effects below.
+// Sprites are full color art, so shapes are drawn flat in this mode.
+static IndexedBitmap* indexedTarget;
+static bool           g_indexedRendering = false;
+
+// Draws flat anti-aliased shapes in place of the sprites, 32-bit target only.
+// Both flags are only touched by the thread that renders.
+static bool g_antiAliasing = false;
+
+// Palette layout of the indexed target. Tile rows get an entry each so
+// their colors can cycle without touching a pixel.
+static constexpr u8  PALETTE_BACKGROUND      = 0;
+static constexpr u8  PALETTE_BALL            = 1;
+static constexpr u8  PALETTE_PADDLE          = 2;
+static constexpr u8  PALETTE_TILE_PARTICLE   = 3;
+static constexpr u8  PALETTE_PADDLE_PARTICLE = 4;
+static constexpr u8  PALETTE_TILE_ROWS       = 5;
+static constexpr u32 PALETTE_TILE_ROW_COUNT  = 8;
+
+struct PaletteEffects {
+    float time;
+    float ballLostFlash; // 1 right after a ball is lost, fades to 0
+};
+static PaletteEffects paletteEffects;
+static Palette        palette;
+
+static void updateEffects(GameEvents* events, float deltaSeconds) {
+    paletteEffects.time += deltaSeconds;
+    paletteEffects.ballLostFlash = max(0.0f, paletteEffects.ballLostFlash - 2.0f*deltaSeconds);
+    for (u32 i = 0; i < events->count; i++) {
+        if (events->events[i].type == GAME_EVENT_BALL_LOST) {
+            paletteEffects.ballLostFlash = 1.0f;
+        }
+    }
+
+    if (!particles) {
+        return;
+    }
+
+    updateParticles(particles, deltaSeconds);
+    for (u32 i = 0; i < events->count; i++) {
+        GameEvent* event = &events->events[i];
+        if (event->type == GAME_EVENT_TILE_DESTROYED) {
+            emitParticleBurst(particles, event->position, event->halfExtents, 0xffff0000, 400, 250.0f,
+                              PALETTE_TILE_PARTICLE);
+        } else if (event->type == GAME_EVENT_PADDLE_HIT) {
+            emitParticleBurst(particles, event->position, event->halfExtents, 0xff00ffff, 40, 150.0f,
+                              PALETTE_PADDLE_PARTICLE);
+        }
+    }
+}
+
+static u32 packColor(float r, float g, float b) {
+    return 0xff000000 | ((u32)(r*255.0f + 0.5f) << 16) | ((u32)(g*255.0f + 0.5f) << 8) | (u32)(b*255.0f + 0.5f);
+}
+
+// All palette effects happen here, the indexed pixels stay as drawn
+static void updatePalette(Palette* palette, PaletteEffects* effects) {
+    float flash = effects->ballLostFlash;
+    palette->colors[PALETTE_BACKGROUND]      = packColor(0.5f*flash, 0, 0);
+    palette->colors[PALETTE_BALL]            = 0xff00ff00;
+    palette->colors[PALETTE_PADDLE]          = 0xff00ffff;
+    palette->colors[PALETTE_TILE_PARTICLE]   = 0xffff0000;
+    palette->colors[PALETTE_PADDLE_PARTICLE] = 0xff00ffff;
+    for (u32 row = 0; row < PALETTE_TILE_ROW_COUNT; row++) {
+        float phase = F_TAU * (0.25f*effects->time + (float)row / PALETTE_TILE_ROW_COUNT);
+        palette->colors[PALETTE_TILE_ROWS + row] = packColor(0.75f + 0.25f*sinf(phase),
+                                                             0.3f + 0.3f*sinf(phase + F_TAU/3),
+                                                             0.3f + 0.3f*sinf(phase + 2*F_TAU/3));
+    }
+}
+
+static void renderIndexed(GameState* game, IndexedBitmap* target) {
+    Tiles* tiles = &game->tiles;
+    Ball*  ball  = &game->ball;
+
+    clearIndexed(target, PALETTE_BACKGROUND);
+
+    for (int w = 0; w < TILE_MASK_WORDS; w++) {
+        u64 mask = tiles->alive[w];
+        while (mask) {
+            int id = w * 64 + countTrailingZeros(mask);
+            mask &= mask - 1;
+            Vec2 center   = vec2(tiles->centerX[id], tiles->centerY[id]);
+            Vec2 halfSize = vec2(tiles->halfExtentX[id], tiles->halfExtentY[id]);
+            u32  row      = (u32)(center.y / 25.0f) % PALETTE_TILE_ROW_COUNT;
+            drawSquareIndexed((u8)(PALETTE_TILE_ROWS + row), center, halfSize, target);
+        }
+    }
+
+    if (particles) {
+        drawParticlesIndexed(particles, target);
+    }
+
+    drawCircleIndexed(PALETTE_BALL, ball->circle.center, ball->circle.radius, target);
+    for (u32 i = 0; i < game->playerCount; i++) {
+        drawSquareIndexed(PALETTE_PADDLE, game->players[i].center, game->players[i].halfExtents, target);
+    }
+}
+
+static void drawSceneBox(Bitmap* sprite, u32 color, Vec2 center, Vec2 halfSize, Bitmap* bitmap) {
+    if (g_antiAliasing) {
+        drawSquareAA(color, center, halfSize, bitmap);
+    } else if (sprite) {
+        drawBitmap(sprite, center, halfSize, bitmap);
+    } else {
+        drawSquare(color, center, halfSize, bitmap);
+    }
+}
+
+static void drawSceneCircle(Bitmap* sprite, u32 color, Vec2 center, float radius, Bitmap* bitmap) {
+    if (g_antiAliasing) {
+        drawCircleAA(color, center, radius, bitmap);
+    } else if (sprite) {
+        drawBitmap(sprite, center, vec2(radius), bitmap);
+    } else {
+        drawCircle(color, center, radius, bitmap);
+    }
+}
+
+static void renderFullColor(GameState* game, Bitmap* bitmap) {
+    Tiles* tiles = &game->tiles;
+    Ball*  ball  = &game->ball;
+
+    { // clear backbuffer to black
+        u32* p = bitmap->data;
+        for (int y = 0; y < (int)bitmap->height; y++) {
+            for (int x = 0; x < (int)bitmap->width; x++) {
+                *p++ = 0xff000000;
+            }
+        }
+    }
+
+    for (int w = 0; w < TILE_MASK_WORDS; w++) {
+        u64 mask = tiles->alive[w];
+        while (mask) {
+            int id = w * 64 + countTrailingZeros(mask);
+            mask &= mask - 1;
+            Vec2 center   = vec2(tiles->centerX[id], tiles->centerY[id]);
+            Vec2 halfSize = vec2(tiles->halfExtentX[id], tiles->halfExtentY[id]);
+            drawSceneBox(sprites.tile, 0xffff0000, center, halfSize, bitmap);
+        }
+    }
+
+    if (particles) {
+        drawParticles(particles, bitmap);
+    }
+
+    drawSceneCircle(sprites.ball, 0xff00ff00, ball->circle.center, ball->circle.radius, bitmap);
+    for (u32 i = 0; i < game->playerCount; i++) {
+        Box* player = &game->players[i];
+        drawSceneBox(sprites.paddle, 0xff00ffff, player->center, player->halfExtents, bitmap);
+    }
+}
+
+static void render(GameState* game, Bitmap* bitmap) {
+    if (indexedTarget && g_indexedRendering) {
+        renderIndexed(game, indexedTarget);
+        updatePalette(&palette, &paletteEffects);
+        expandIndexed(indexedTarget, &palette, bitmap);
+    } else {
+        renderFullColor(game, bitmap);
+    }
+
+    // text is blended, so it always goes on top of the 32-bit frame
+    if (font) {
+        if (game->playerCount > 1) {
+            pushTextF(textBatch, font, vec2(20, HEIGHT - 28), 0xffffffff, "P1 %d", game->scores[0]);
+            pushTextF(textBatch, font, vec2(20, 12), 0xffffffff, "P2 %d", game->scores[1]);
+        } else {
+            pushTextF(textBatch, font, vec2(20, 12), 0xffffffff, "SCORE %d", game->scores[0]);
+        }
+        flushText(textBatch, font, bitmap);
+    }
+}
+
+#endif // BREAKOUT_SCENE_H_
@@ -0,0 +1,255 @@
+#ifndef BREAKOUT_TEXT_H_
+#define BREAKOUT_TEXT_H_
+
+#include "render.h"
+
+#include <stdarg.h>
+
+// Built-in 5x7 font covering ' ' to '_', lower case letters are drawn as upper case.
+// Each row stores the pixels in the low 5 bits, leftmost pixel in bit 4.
+#define FONT_GLYPH_WIDTH   5
+#define FONT_GLYPH_HEIGHT  7
+#define FONT_FIRST_CHAR    32
+#define FONT_CHAR_COUNT    64
+#define FONT_ATLAS_COLUMNS 16
+
+static const u8 fontGlyphs[FONT_CHAR_COUNT][FONT_GLYPH_HEIGHT] = {
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // ' '
+    {0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x04}, // !
+    {0x0a, 0x0a, 0x00, 0x00, 0x00, 0x00, 0x00}, // "
+    {0x0a, 0x0a, 0x1f, 0x0a, 0x1f, 0x0a, 0x0a}, // #
+    {0x04, 0x0f, 0x14, 0x0e, 0x05, 0x1e, 0x04}, // $
+    {0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03}, // %
+    {0x0c, 0x12, 0x14, 0x08, 0x15, 0x12, 0x0d}, // &
+    {0x04, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00}, // "'"
+    {0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02}, // (
+    {0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08}, // )
+    {0x00, 0x04, 0x15, 0x0e, 0x15, 0x04, 0x00}, // *
+    {0x00, 0x04, 0x04, 0x1f, 0x04, 0x04, 0x00}, // +
+    {0x00, 0x00, 0x00, 0x00, 0x0c, 0x04, 0x08}, // ,
+    {0x00, 0x00, 0x00, 0x1f, 0x00, 0x00, 0x00}, // -
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x0c, 0x0c}, // .
+    {0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00}, // /
+    {0x0e, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0e}, // 0
+    {0x04, 0x0c, 0x04, 0x04, 0x04, 0x04, 0x0e}, // 1
+    {0x0e, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1f}, // 2
+    {0x1f, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0e}, // 3
+    {0x02, 0x06, 0x0a, 0x12, 0x1f, 0x02, 0x02}, // 4
+    {0x1f, 0x10, 0x1e, 0x01, 0x01, 0x11, 0x0e}, // 5
+    {0x06, 0x08, 0x10, 0x1e, 0x11, 0x11, 0x0e}, // 6
+    {0x1f, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08}, // 7
+    {0x0e, 0x11, 0x11, 0x0e, 0x11, 0x11, 0x0e}, // 8
+    {0x0e, 0x11, 0x11, 0x0f, 0x01, 0x02, 0x0c}, // 9
+    {0x00, 0x0c, 0x0c, 0x00, 0x0c, 0x0c, 0x00}, // :
+    {0x00, 0x0c, 0x0c, 0x00, 0x0c, 0x04, 0x08}, // ;
+    {0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02}, // <
+    {0x00, 0x00, 0x1f, 0x00, 0x1f, 0x00, 0x00}, // =
+    {0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08}, // >
+    {0x0e, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04}, // ?
+    {0x0e, 0x11, 0x01, 0x0d, 0x15, 0x15, 0x0e}, // @
+    {0x0e, 0x11, 0x11, 0x1f, 0x11, 0x11, 0x11}, // A
+    {0x1e, 0x11, 0x11, 0x1e, 0x11, 0x11, 0x1e}, // B
+    {0x0e, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0e}, // C
+    {0x1c, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1c}, // D
+    {0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x1f}, // E
+    {0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x10}, // F
+    {0x0e, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0f}, // G
+    {0x11, 0x11, 0x11, 0x1f, 0x11, 0x11, 0x11}, // H
+    {0x0e, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0e}, // I
+    {0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0c}, // J
+    {0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11}, // K
+    {0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1f}, // L
+    {0x11, 0x1b, 0x15, 0x15, 0x11, 0x11, 0x11}, // M
+    {0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11}, // N
+    {0x0e, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e}, // O
+    {0x1e, 0x11, 0x11, 0x1e, 0x10, 0x10, 0x10}, // P
+    {0x0e, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0d}, // Q
+    {0x1e, 0x11, 0x11, 0x1e, 0x14, 0x12, 0x11}, // R
+    {0x0f, 0x10, 0x10, 0x0e, 0x01, 0x01, 0x1e}, // S
+    {0x1f, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04}, // T
+    {0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e}, // U
+    {0x11, 0x11, 0x11, 0x11, 0x11, 0x0a, 0x04}, // V
+    {0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0a}, // W
+    {0x11, 0x11, 0x0a, 0x04, 0x0a, 0x11, 0x11}, // X
+    {0x11, 0x11, 0x0a, 0x04, 0x04, 0x04, 0x04}, // Y
+    {0x1f, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1f}, // Z
+    {0x0e, 0x08, 0x08, 0x08, 0x08, 0x08, 0x0e}, // [
+    {0x00, 0x10, 0x08, 0x04, 0x02, 0x01, 0x00}, // '\\'
+    {0x0e, 0x02, 0x02, 0x02, 0x02, 0x02, 0x0e}, // ]
+    {0x04, 0x0a, 0x11, 0x00, 0x00, 0x00, 0x00}, // ^
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1f}, // _
+};
+
+// Glyphs are rasterized once into the atlas at the requested scale, white
+// with a black drop shadow, and tinted while they are blitted.
+struct Font {
+    Bitmap atlas;
+    u32    cellWidth;
+    u32    cellHeight;
+    u32    advance;
+    u32    lineHeight;
+};
+
+struct GlyphQuad {
+    i32 x;
+    i32 y;
+    u32 color;
+    u32 glyph;
+};
+
+struct TextBatch {
+    GlyphQuad* glyphs;
+    u32        count;
+    u32        capacity;
+};
+
+static u32 glyphIndex(char c) {
+    if (c >= 'a' && c <= 'z') {
+        c = c - 'a' + 'A';
+    }
+    if (c < FONT_FIRST_CHAR || c >= FONT_FIRST_CHAR + FONT_CHAR_COUNT) {
+        c = '?';
+    }
+    return (u32)(c - FONT_FIRST_CHAR);
+}
+
+static Font* makeFont(Arena* arena, u32 scale) {
+    Font* font = push(arena, Font);
+    if (!font) {
+        return NULL;
+    }
+    font->cellWidth  = (FONT_GLYPH_WIDTH  + 1) * scale;
+    font->cellHeight = (FONT_GLYPH_HEIGHT + 1) * scale;
+    font->advance    = font->cellWidth;
+    font->lineHeight = font->cellHeight + scale;
+
+    u32 rows = (FONT_CHAR_COUNT + FONT_ATLAS_COLUMNS - 1) / FONT_ATLAS_COLUMNS;
+    font->atlas.width  = FONT_ATLAS_COLUMNS * font->cellWidth;
+    font->atlas.height = rows * font->cellHeight;
+    font->atlas.data   = (u32*)allocate(arena, sizeof(u32) * font->atlas.width*font->atlas.height, 16);
+    if (!font->atlas.data) {
+        return NULL;
+    }
+    memset(font->atlas.data, 0, sizeof(u32) * font->atlas.width*font->atlas.height);
+
+    for (u32 glyph = 0; glyph < FONT_CHAR_COUNT; glyph++) {
+        u32 cellX = (glyph % FONT_ATLAS_COLUMNS) * font->cellWidth;
+        u32 cellY = (glyph / FONT_ATLAS_COLUMNS) * font->cellHeight;
+        // shadow first, offset by one font pixel, then the glyph on top
+        for (u32 pass = 0; pass < 2; pass++) {
+            u32 offset = pass == 0 ? scale : 0;
+            u32 color  = pass == 0 ? 0xff000000 : 0xffffffff;
+            for (u32 y = 0; y < FONT_GLYPH_HEIGHT*scale; y++) {
+                u8  bits = fontGlyphs[glyph][y / scale];
+                u32* p   = &font->atlas.data[(cellY + y + offset) * font->atlas.width + cellX + offset];
+                for (u32 x = 0; x < FONT_GLYPH_WIDTH*scale; x++) {
+                    if (bits & (0x10 >> (x / scale))) {
+                        p[x] = color;
+                    }
+                }
+            }
+        }
+    }
+    return font;
+}
+
+static TextBatch* makeTextBatch(Arena* arena, u32 capacity) {
+    TextBatch* batch = push(arena, TextBatch);
+    if (!batch) {
+        return NULL;
+    }
+    batch->glyphs   = pushCount(arena, GlyphQuad, capacity);
+    batch->count    = 0;
+    batch->capacity = batch->glyphs ? capacity : 0;
+    return batch;
+}
+
+static u32 measureText(Font* font, const char* text) {
+    return (u32)strlen(text) * font->advance;
+}
+
+// color is premultiplied, position is the top left corner of the first glyph
+static void pushText(TextBatch* batch, Font* font, Vec2 position, u32 color, const char* text) {
+    i32 x = (i32)position.x;
+    i32 y = (i32)position.y;
+    for (const char* c = text; *c; c++) {
+        if (*c == '\n') {
+            x  = (i32)position.x;
+            y += font->lineHeight;
+            continue;
+        }
+        if (*c != ' ' && batch->count < batch->capacity) {
+            batch->glyphs[batch->count++] = {x, y, color, glyphIndex(*c)};
+        }
+        x += font->advance;
+    }
+}
+
+static void pushTextF(TextBatch* batch, Font* font, Vec2 position, u32 color, const char* format, ...) {
+    char text[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    pushText(batch, font, position, color, text);
+}
+
+// atlas pixels multiplied by the premultiplied tint, four at a time
+static __m128i tintPixels4(__m128i pixels, __m128i tint16) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i bias = _mm_set1_epi16(128);
+    __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(pixels, zero), tint16), bias);
+    __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(pixels, zero), tint16), bias);
+    lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+    hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+    return _mm_packus_epi16(lo, hi);
+}
+
+static void blitGlyph(Bitmap* bitmap, Font* font, GlyphQuad* quad) {
+    i32 minX = max(quad->x, 0);
+    i32 minY = max(quad->y, 0);
+    i32 maxX = min(quad->x + (i32)font->cellWidth,  (i32)bitmap->width);
+    i32 maxY = min(quad->y + (i32)font->cellHeight, (i32)bitmap->height);
+    if (minX >= maxX || minY >= maxY) {
+        return;
+    }
+
+    u32 atlasX = (quad->glyph % FONT_ATLAS_COLUMNS) * font->cellWidth  + (u32)(minX - quad->x);
+    u32 atlasY = (quad->glyph / FONT_ATLAS_COLUMNS) * font->cellHeight + (u32)(minY - quad->y);
+    i32 count  = maxX - minX;
+    __m128i zero   = _mm_setzero_si128();
+    __m128i tint16 = _mm_unpacklo_epi8(_mm_set1_epi32((int)quad->color), zero);
+    bool    white  = quad->color == 0xffffffff;
+
+    for (i32 y = minY; y < maxY; y++) {
+        u32* src = &font->atlas.data[(atlasY + (u32)(y - minY)) * font->atlas.width + atlasX];
+        u32* dst = &bitmap->data[y * bitmap->width + minX];
+        i32 x = 0;
+        for (; x + 4 <= count; x += 4) {
+            __m128i s = _mm_loadu_si128((__m128i*)(src + x));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi32(s, zero)) == 0xffff) {
+                continue;
+            }
+            if (!white) {
+                s = tintPixels4(s, tint16);
+            }
+            __m128i d = _mm_loadu_si128((__m128i*)(dst + x));
+            _mm_storeu_si128((__m128i*)(dst + x), blendPremultiplied4(s, d));
+        }
+        for (; x < count; x++) {
+            if (src[x]) {
+                u32 s = white ? src[x] : (u32)_mm_cvtsi128_si32(tintPixels4(_mm_cvtsi32_si128((int)src[x]), tint16));
+                dst[x] = blendPremultiplied(s, dst[x]);
+            }
+        }
+    }
+}
+
+static void flushText(TextBatch* batch, Font* font, Bitmap* bitmap) {
+    for (u32 i = 0; i < batch->count; i++) {
+        blitGlyph(bitmap, font, &batch->glyphs[i]);
+    }
+    batch->count = 0;
+}
+
+#endif // BREAKOUT_TEXT_H_
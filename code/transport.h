@@ -0,0 +1,112 @@
+#ifndef BREAKOUT_TRANSPORT_H_
+#define BREAKOUT_TRANSPORT_H_
+
+#include "base.h"
+
+// Unreliable, unordered datagrams between two peers. Packets may be dropped,
+// duplicated or reordered, whoever sits on top has to cope with that.
+struct Transport {
+    void* user;
+    void  (*send)(void* user, void* data, u32 size);
+    // returns the size of the next received packet, 0 when there is none
+    u32   (*receive)(void* user, void* buffer, u32 capacity);
+};
+
+// In-process link that delays, jitters and drops packets, for testing
+// netcode without a network. A link carries packets in one direction, two
+// of them make a LoopbackEndpoint pair.
+
+#define LOOPBACK_MAX_PACKET_SIZE 256
+#define LOOPBACK_MAX_IN_FLIGHT   256
+
+struct LoopbackPacket {
+    double deliveryTime;
+    u32    size;
+    u8     data[LOOPBACK_MAX_PACKET_SIZE];
+};
+
+struct LoopbackLink {
+    LoopbackPacket packets[LOOPBACK_MAX_IN_FLIGHT];
+    u32            count;
+    double         time;
+
+    float          latencySeconds;
+    float          jitterSeconds;
+    float          lossRate;
+    u32            random;
+
+    u64            sent;
+    u64            dropped;
+};
+
+struct LoopbackEndpoint {
+    LoopbackLink* outgoing;
+    LoopbackLink* incoming;
+};
+
+static void initLoopbackLink(LoopbackLink* link, float latencySeconds, float jitterSeconds,
+                             float lossRate, u32 seed) {
+    link->count          = 0;
+    link->time           = 0;
+    link->latencySeconds = latencySeconds;
+    link->jitterSeconds  = jitterSeconds;
+    link->lossRate       = lossRate;
+    link->random         = seed ? seed : 1;
+    link->sent           = 0;
+    link->dropped        = 0;
+}
+
+static void advanceLoopbackLink(LoopbackLink* link, float deltaSeconds) {
+    link->time += deltaSeconds;
+}
+
+static void loopbackSend(void* user, void* data, u32 size) {
+    LoopbackLink* link = ((LoopbackEndpoint*)user)->outgoing;
+    ASSERT(size <= LOOPBACK_MAX_PACKET_SIZE);
+    link->sent++;
+
+    // a full link drops like a full router queue would
+    if (randomUnilateral(&link->random) < link->lossRate || link->count == LOOPBACK_MAX_IN_FLIGHT) {
+        link->dropped++;
+        return;
+    }
+
+    float jitter = link->jitterSeconds * randomUnilateral(&link->random);
+    LoopbackPacket* packet = &link->packets[link->count++];
+    packet->deliveryTime = link->time + link->latencySeconds + jitter;
+    packet->size         = size;
+    memcpy(packet->data, data, size);
+}
+
+// Jitter reorders packets, whichever is due first is delivered first
+static u32 loopbackReceive(void* user, void* buffer, u32 capacity) {
+    LoopbackLink* link = ((LoopbackEndpoint*)user)->incoming;
+    u32 due = link->count;
+    for (u32 i = 0; i < link->count; i++) {
+        LoopbackPacket* packet = &link->packets[i];
+        if (packet->deliveryTime <= link->time &&
+            (due == link->count || packet->deliveryTime < link->packets[due].deliveryTime)) {
+            due = i;
+        }
+    }
+    if (due == link->count) {
+        return 0;
+    }
+
+    LoopbackPacket* packet = &link->packets[due];
+    u32 size = packet->size;
+    ASSERT(size <= capacity);
+    memcpy(buffer, packet->data, size);
+    *packet = link->packets[--link->count];
+    return size;
+}
+
+static Transport makeLoopbackTransport(LoopbackEndpoint* endpoint) {
+    return {
+        .user    = endpoint,
+        .send    = loopbackSend,
+        .receive = loopbackReceive,
+    };
+}
+
+#endif // BREAKOUT_TRANSPORT_H_